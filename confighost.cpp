@@ -4,6 +4,8 @@
 #include <QFileInfo>
 #include <QTextFrame>
 #include <QTextStream>
+#include <algorithm>
+#include <climits>
 
 using namespace NovelBase;
 
@@ -12,7 +14,7 @@ using namespace NovelBase;
     throw new NovelBase::WsException(q.lastError().text());
 
 ConfigHost::ConfigHost(const QString &wfPath)
-    :warrings_filepath(wfPath)
+    :warrings_filepath(wfPath), keywords_revision(0), buckets_revision(-1)
 {
     qRegisterMetaType<QTextBlock>("QTextBlock");
 
@@ -161,13 +163,6 @@ QList<std::tuple<QString, int, QString>> ConfigHost::warringWords() const
     return warring_words;
 }
 
-QList<std::tuple<QString, int, QString>> ConfigHost::getKeywordsWithMSG() const
-{
-    QMutexLocker locker(const_cast<QMutex*>(&mutex));
-
-    return keywords_list;
-}
-
 QString ConfigHost::warringsFilePath() const{
     return warrings_filepath;
 }
@@ -176,34 +171,117 @@ void ConfigHost::appendKeyword(QString tableRealname, int uniqueID, const QStrin
 {
     QMutexLocker locker((&mutex));
 
-    for (int index=0; index < keywords_list.size(); ++index) {
-        auto tuple = keywords_list.at(index);
-        auto ref_tablename = std::get<0>(tuple);
-        auto unique_id = std::get<1>(tuple);
+    keywords_revision++;
+    auto key = qMakePair(tableRealname, uniqueID);
+    if(keywords_registed.contains(key))
+        _sorted_remove(keywords_registed.value(key), tableRealname, uniqueID);
+    _sorted_insert(words, tableRealname, uniqueID);
+    keywords_registed.insert(key, words);
+}
 
-        if(ref_tablename == tableRealname && uniqueID == unique_id){
-            keywords_list.insert(index, std::make_tuple(tableRealname, uniqueID, words));
-            keywords_list.removeAt(index+1);
-            return;
-        }
-    }
+void ConfigHost::removeKeyword(QString tableRealname, int uniqueID)
+{
+    QMutexLocker locker(&mutex);
 
-    keywords_list.append(std::make_tuple(tableRealname, uniqueID, words));
+    auto key = qMakePair(tableRealname, uniqueID);
+    if(!keywords_registed.contains(key))
+        return;
+    keywords_revision++;
+    _sorted_remove(keywords_registed.take(key), tableRealname, uniqueID);
 }
 
-void ConfigHost::removeKeyword(QString tableRealname, int uniqueID)
+void ConfigHost::appendKeywords(const QList<std::tuple<QString, int, QString>> &keywords)
 {
     QMutexLocker locker(&mutex);
+    if(keywords.isEmpty())
+        return;
 
-    for (int index=0; index < keywords_list.size(); ++index) {
-        auto tuple = keywords_list.at(index);
-        auto ref_tablename = std::get<0>(tuple);
-        auto unique_id = std::get<1>(tuple);
+    keywords_revision++;
+    for (auto tuple : keywords)
+        keywords_registed.insert(qMakePair(std::get<0>(tuple), std::get<1>(tuple)), std::get<2>(tuple));
 
-        if(ref_tablename == tableRealname && uniqueID == unique_id){
-            keywords_list.removeAt(index+1);
+    // 按登记表整体重建有序表，避免逐条插入
+    keywords_sorted.clear();
+    keywords_sorted.reserve(keywords_registed.size());
+    for (auto it=keywords_registed.constBegin(); it!=keywords_registed.constEnd(); ++it)
+        keywords_sorted.append(std::make_tuple(it.value(), it.key().first, it.key().second));
+    std::sort(keywords_sorted.begin(), keywords_sorted.end());
+}
+
+QStringList ConfigHost::keywordsCompletion(const QString &prefix, int topk) const
+{
+    QMutexLocker locker(const_cast<QMutex*>(&mutex));
+
+    QStringList result;
+    if(prefix.isEmpty())
+        return result;
+
+    auto it = std::lower_bound(keywords_sorted.constBegin(), keywords_sorted.constEnd(), std::make_tuple(prefix, QString(), INT_MIN));
+    for (; it!=keywords_sorted.constEnd() && result.size() < topk; ++it) {
+        auto words = std::get<0>(*it);
+        if(!words.startsWith(prefix))
+            break;
+        if(result.isEmpty() || result.last() != words)
+            result << words;
+    }
+    return result;
+}
+
+void ConfigHost::matchKeywords(const QString &text, QList<std::tuple<QString, int, int, int>> &hits) const
+{
+    QHash<QChar, QList<std::tuple<QString, QString, int>>> buckets;
+    {
+        QMutexLocker locker(const_cast<QMutex*>(&mutex));
+        if(buckets_revision != keywords_revision){
+            keywords_buckets.clear();
+            for (auto tuple : keywords_sorted) {
+                if(std::get<0>(tuple).isEmpty())
+                    continue;
+                keywords_buckets[std::get<0>(tuple).at(0)] << tuple;
+            }
+            buckets_revision = keywords_revision;
         }
+        buckets = keywords_buckets;
     }
+
+    for (int pos=0; pos<text.length(); ++pos) {
+        auto it = buckets.constFind(text.at(pos));
+        if(it == buckets.constEnd())
+            continue;
+
+        for (auto tuple : it.value()) {
+            auto &words = std::get<0>(tuple);
+            if(text.midRef(pos, words.length()) == words)
+                hits << std::make_tuple(std::get<1>(tuple), std::get<2>(tuple), pos, words.length());
+        }
+    }
+}
+
+int ConfigHost::keywordsRevision() const
+{
+    QMutexLocker locker(const_cast<QMutex*>(&mutex));
+    return keywords_revision;
+}
+
+QHash<QPair<QString, int>, QString> ConfigHost::registeredKeywords() const
+{
+    QMutexLocker locker(const_cast<QMutex*>(&mutex));
+    return keywords_registed;
+}
+
+void ConfigHost::_sorted_insert(const QString &words, const QString &tableRealname, int uniqueID)
+{
+    auto tuple = std::make_tuple(words, tableRealname, uniqueID);
+    auto it = std::lower_bound(keywords_sorted.begin(), keywords_sorted.end(), tuple);
+    keywords_sorted.insert(it, tuple);
+}
+
+void ConfigHost::_sorted_remove(const QString &words, const QString &tableRealname, int uniqueID)
+{
+    auto tuple = std::make_tuple(words, tableRealname, uniqueID);
+    auto it = std::lower_bound(keywords_sorted.begin(), keywords_sorted.end(), tuple);
+    if(it != keywords_sorted.end() && *it == tuple)
+        keywords_sorted.erase(it);
 }
 
 ConfigHost::ViewConfigController::ViewConfigController(ConfigHost &config):host(config){}
@@ -102,13 +102,36 @@ public:
 
     QList<std::tuple<QString, int, QString> > warringWords() const;
 
-    QList<std::tuple<QString, int, QString>> getKeywordsWithMSG() const;
-
     QString warringsFilePath() const;
 
+    /**
+     * @brief 关键字前缀补全，按字典序返回不重复的关键字
+     * @param prefix 前缀
+     * @param topk 最大返回数
+     */
+    QStringList keywordsCompletion(const QString &prefix, int topk) const;
+    /**
+     * @brief 单趟扫描文本，按首字分桶匹配全部关键字，渲染与提及索引共用
+     * @param hits 匹配结果：tableRealname-string : unique_id-int : start : length
+     */
+    void matchKeywords(const QString &text, QList<std::tuple<QString, int, int, int>> &hits) const;
+    /**
+     * @brief 关键字登记版本，每次增删改递增
+     */
+    int keywordsRevision() const;
+    /**
+     * @brief 当前全部关键字登记：(tableRealname, unique_id) : keyword-string
+     */
+    QHash<QPair<QString, int>, QString> registeredKeywords() const;
+
 public slots:
     void appendKeyword(QString tableRealname, int uniqueID, const QString &words);
     void removeKeyword(QString tableRealname, int uniqueID);
+    /**
+     * @brief 批量登记关键字，统一排序一次，供载入与导入使用
+     * @param keywords tableRealname-string : unique_id-int : keyword-string
+     */
+    void appendKeywords(const QList<std::tuple<QString, int, QString>> &keywords);
 
 private:
     QMutex mutex;
@@ -117,7 +140,18 @@ private:
 
     // tableRealname-string : unique_id-int : keyword-string
     QList<std::tuple<QString, int, QString>> warring_words;
-    QList<std::tuple<QString, int, QString>> keywords_list;
+    // 有序关键字：keyword-string : tableRealname-string : unique_id-int
+    QList<std::tuple<QString, QString, int>> keywords_sorted;
+    // (tableRealname, unique_id) : keyword-string
+    QHash<QPair<QString, int>, QString> keywords_registed;
+
+    int keywords_revision;
+    // 首字分桶：first-char : (keyword-string : tableRealname-string : unique_id-int)，登记变化后惰性重建
+    mutable QHash<QChar, QList<std::tuple<QString, QString, int>>> keywords_buckets;
+    mutable int buckets_revision;
+
+    void _sorted_insert(const QString &words, const QString &tableRealname, int uniqueID);
+    void _sorted_remove(const QString &words, const QString &tableRealname, int uniqueID);
 };
 
 #endif // CONFIGHOST_H
@@ -1,15 +1,23 @@
 #include "dbaccess.h"
 #include "common.h"
 
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QFile>
+#include <QSet>
+#include <QVector>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QtDebug>
+#include <algorithm>
+#include <limits>
+#include <tuple>
 
 using namespace NovelBase;
 
 DBAccess::DBAccess(ConfigHost &configPort)
-    : config_host(configPort){}
+    : config_host(configPort), paragraph_layout_threshold(16384), schema_loaded(false), schema_root_id(INT_MAX),
+      revision_chunks_dirty(false){}
 
 void DBAccess::loadFile(const QString &filePath)
 {
@@ -20,7 +28,12 @@ void DBAccess::loadFile(const QString &filePath)
 
     QSqlQuery x(dbins);
     x.exec("PRAGMA foreign_keys = ON;");
+    // WAL模式下读写互不阻塞，备份连接得以在单个读事务内分批复制
+    x.exec("PRAGMA journal_mode = WAL;");
+    revision_chunks_dirty = false;
 
+    _invalidate_schema_catalog();
+    _ensure_extended_tables();
     _push_all_keywords_to_confighost();
 }
 
@@ -36,8 +49,13 @@ void DBAccess::createEmptyFile(const QString &dest)
 
     QSqlQuery x(dbins);
     x.exec("PRAGMA foreign_keys = ON;");
+    // WAL模式下读写互不阻塞，备份连接得以在单个读事务内分批复制
+    x.exec("PRAGMA journal_mode = WAL;");
+    revision_chunks_dirty = false;
 
+    _invalidate_schema_catalog();
     init_tables(dbins);
+    _ensure_extended_tables();
 }
 
 #define ExSqlQuery(sql) \
@@ -45,18 +63,67 @@ void DBAccess::createEmptyFile(const QString &dest)
     throw new WsException(sql.lastError().text());}
 
 
+// contents_collect.content 压缩存储格式：格式标记 + qCompress(utf8)，旧版本为未压缩文本
+static const QByteArray content_compress_tag = QByteArrayLiteral("WSZ1");
+// contents_collect.content 逐段存储标记：正文位于paragraphs_collect
+static const QByteArray content_paragraphs_tag = QByteArrayLiteral("WSP1");
+
+static QByteArray _encode_chapter_content(const QString &text)
+{
+    return content_compress_tag + qCompress(text.toUtf8());
+}
+
+static bool _decode_chapter_content(const QVariant &value, QString &textOut)
+{
+    if(value.type() == QVariant::ByteArray){
+        auto bytes = value.toByteArray();
+        if(bytes.startsWith(content_compress_tag)){
+            textOut = QString::fromUtf8(qUncompress(bytes.mid(content_compress_tag.length())));
+            return true;
+        }
+    }
+
+    textOut = value.toString();
+    return false;
+}
+
+static bool _is_paragraphs_layout(const QVariant &value)
+{
+    return value.type() == QVariant::ByteArray && value.toByteArray() == content_paragraphs_tag;
+}
+
+static QByteArray _paragraph_digest(const QString &paragraph)
+{
+    return QCryptographicHash::hash(paragraph.toUtf8(), QCryptographicHash::Md5);
+}
+
 QString DBAccess::chapterText(const DBAccess::StoryTreeNode &chapter) const
 {
     if(chapter.type() != StoryTreeNode::Type::CHAPTER)
         throw new WsException("指定节点非章节节点");
 
     auto sql = getStatement();
-    sql.prepare("select content from contents_collect where chapter_ref = :cid");
+    sql.prepare("select id, content from contents_collect where chapter_ref = :cid");
     sql.bindValue(":cid", chapter.uniqueID());
     ExSqlQuery(sql);
 
-    sql.next();
-    return sql.value(0).toString();
+    if(!sql.next())
+        return "";
+
+    if(_is_paragraphs_layout(sql.value(1)))
+        return chapterParagraphs(chapter).join("\n");
+
+    QString text;
+    if(!_decode_chapter_content(sql.value(1), text) && !sql.value(1).isNull()){
+        // 旧格式内容，读取时迁移为压缩格式
+        auto idint = sql.value(0).toInt();
+        sql.prepare("update contents_collect set content = :text where id = :id");
+        sql.bindValue(":text", _encode_chapter_content(text));
+        sql.bindValue(":id", idint);
+        ExSqlQuery(sql);
+    }
+
+    return text;
 }
 
 void DBAccess::resetChapterText(const DBAccess::StoryTreeNode &chapter, const QString &text)
@@ -65,108 +132,274 @@ void DBAccess::resetChapterText(const DBAccess::StoryTreeNode &chapter, const QS
         throw new WsException("指定节点非章节节点");
 
     auto sql = getStatement();
-    sql.prepare("select id from contents_collect where chapter_ref = :cid");
+    sql.prepare("select id, content from contents_collect where chapter_ref = :cid");
     sql.bindValue(":cid", chapter.uniqueID());
     ExSqlQuery(sql);
 
-    if(!sql.next()){
-        sql.prepare("insert into contents_collect "
-                    "(chapter_ref, content) values(:cid, :text)");
-        sql.bindValue(":cid", chapter.uniqueID());
-        sql.bindValue(":text", text);
-        ExSqlQuery(sql);
+    QVariant idint;
+    auto stored_layout = ChapterLayout::WHOLE;
+    if(sql.next()){
+        idint = sql.value(0);
+        if(_is_paragraphs_layout(sql.value(1)))
+            stored_layout = ChapterLayout::PARAGRAPHS;
     }
-    else {
-        auto idint = sql.value(0).toInt();
-        sql.prepare("update contents_collect set "
-                    "content = :text where id = :id");
-        sql.bindValue(":text", text);
-        sql.bindValue(":id", idint);
-        ExSqlQuery(sql);
+    // 缩减至阈值一半以下才转回整章存储，留出区间避免反复切换
+    auto layout = stored_layout;
+    if(text.length() > paragraph_layout_threshold)
+        layout = ChapterLayout::PARAGRAPHS;
+    else if(text.length() < paragraph_layout_threshold / 2)
+        layout = ChapterLayout::WHOLE;
+
+    QByteArray content;
+    switch (layout) {
+        case ChapterLayout::WHOLE:
+            content = _encode_chapter_content(text);
+            break;
+        case ChapterLayout::PARAGRAPHS:
+            content = content_paragraphs_tag;
+            break;
     }
+
+    auto transaction_owned = dbins.transaction();
+    try {
+        if(layout == ChapterLayout::PARAGRAPHS)
+            _reset_chapter_paragraphs(chapter, text.split("\n"));
+        else if(stored_layout == ChapterLayout::PARAGRAPHS){
+            sql.prepare("delete from paragraphs_collect where chapter_ref = :cid");
+            sql.bindValue(":cid", chapter.uniqueID());
+            ExSqlQuery(sql);
+        }
+
+        if(!idint.isValid()){
+            sql.prepare("insert into contents_collect "
+                        "(chapter_ref, content) values(:cid, :text)");
+            sql.bindValue(":cid", chapter.uniqueID());
+            sql.bindValue(":text", content);
+            ExSqlQuery(sql);
+        }
+        else {
+            sql.prepare("update contents_collect set "
+                        "content = :text where id = :id");
+            sql.bindValue(":text", content);
+            sql.bindValue(":id", idint);
+            ExSqlQuery(sql);
+        }
+    } catch (WsException *e) {
+        if(transaction_owned)
+            dbins.rollback();
+        throw e;
+    }
+
+    if(transaction_owned && !dbins.commit())
+        throw new WsException(dbins.lastError().text());
 }
 
+DBAccess::ChapterLayout DBAccess::chapterLayoutOf(const DBAccess::StoryTreeNode &chapter) const
+{
+    if(chapter.type() != StoryTreeNode::Type::CHAPTER)
+        throw new WsException("指定节点非章节节点");
 
-QSqlQuery DBAccess::getStatement() const
+    auto sql = getStatement();
+    sql.prepare("select content from contents_collect where chapter_ref = :cid");
+    sql.bindValue(":cid", chapter.uniqueID());
+    ExSqlQuery(sql);
+
+    if(sql.next() && _is_paragraphs_layout(sql.value(0)))
+        return ChapterLayout::PARAGRAPHS;
+    return ChapterLayout::WHOLE;
+}
+
+QStringList DBAccess::chapterParagraphs(const DBAccess::StoryTreeNode &chapter, int offset, int count) const
 {
-    return QSqlQuery(dbins);
+    if(chapterLayoutOf(chapter) == ChapterLayout::WHOLE)
+        return chapterText(chapter).split("\n").mid(offset, count);
+
+    auto sql = getStatement();
+    sql.prepare("select content from paragraphs_collect where chapter_ref = :cid "
+                "order by okey limit :cnt offset :ofs");
+    sql.bindValue(":cid", chapter.uniqueID());
+    sql.bindValue(":cnt", count);
+    sql.bindValue(":ofs", offset);
+    ExSqlQuery(sql);
+
+    QStringList paragraphs;
+    while (sql.next())
+        paragraphs << sql.value(0).toString();
+
+    return paragraphs;
 }
 
-void DBAccess::disconnect_listen_connect(QStandardItemModel *model)
+void DBAccess::resetChapterWordsCount(const DBAccess::StoryTreeNode &chapter, int words)
 {
-    disconnect(model, &QStandardItemModel::itemChanged,    this,   &DBAccess::listen_keywordsmodel_itemchanged);
+    if(chapter.type() != StoryTreeNode::Type::CHAPTER)
+        throw new WsException("指定节点非章节节点");
+
+    auto sql = getStatement();
+    sql.prepare("insert or replace into chapter_words (chapter_ref, words) values(:cid, :words)");
+    sql.bindValue(":cid", chapter.uniqueID());
+    sql.bindValue(":words", words);
+    ExSqlQuery(sql);
 }
 
-void DBAccess::connect_listen_connect(QStandardItemModel *model)
+QHash<int, int> DBAccess::chaptersWordsCount() const
 {
-    connect(model, &QStandardItemModel::itemChanged,    this,   &DBAccess::listen_keywordsmodel_itemchanged);
+    auto sql = getStatement();
+    sql.prepare("select chapter_ref, words from chapter_words");
+    ExSqlQuery(sql);
+
+    QHash<int, int> result;
+    while (sql.next())
+        result.insert(sql.value(0).toInt(), sql.value(1).toInt());
+    return result;
 }
 
-void DBAccess::listen_keywordsmodel_itemchanged(QStandardItem *item)
+void DBAccess::_reset_chapter_paragraphs(const DBAccess::StoryTreeNode &chapter, const QStringList &paragraphs)
 {
     auto sql = getStatement();
-    KeywordController kwdl(*this);
-
-    switch (item->column()) {
-        case 0:{
-                auto id = item->data(Qt::UserRole+1).toInt();
-                auto table_ref = item->data(Qt::UserRole+2).toString();
-                sql.prepare("update "+table_ref+" set name=:nm where id=:id");
-                sql.bindValue(":nm", item->text());
-                sql.bindValue(":id", id);
-                ExSqlQuery(sql);
+    sql.prepare("select id, okey, digest from paragraphs_collect where chapter_ref = :cid order by okey");
+    sql.bindValue(":cid", chapter.uniqueID());
+    ExSqlQuery(sql);
 
-                config_host.appendKeyword(table_ref, id, item->text());
-            }break;
-        case 1:{
-                auto table_root = item->index().parent();
-                auto id = table_root.data(Qt::UserRole+1).toInt();         // id-number
-                auto t_name = table_root.data(Qt::UserRole+2).toString();  // table-name
-                auto t_type = table_root.data(Qt::UserRole+3).toString();  // table-type
-
-                sql.prepare(QString("update "+t_name+" set field_%1=:v where id=:id").arg(item->row()));
-                sql.bindValue(":id", id);
-                sql.bindValue(":v", item->data());
-                ExSqlQuery(sql);
+    // 已存段落：id : order-key : digest
+    QList<std::tuple<int, double, QByteArray>> stored;
+    while (sql.next())
+        stored << std::make_tuple(sql.value(0).toInt(), sql.value(1).toDouble(), sql.value(2).toByteArray());
+
+    QList<QByteArray> digests;
+    for (auto para : paragraphs)
+        digests << _paragraph_digest(para);
+
+    // 新段落对应的已存段落索引，-1代表新段落
+    QList<int> matched;
+    for (int index=0; index<digests.size(); ++index)
+        matched << -1;
+
+    // 首尾相同段落直接对齐
+    int prefix = 0;
+    while (prefix < digests.size() && prefix < stored.size() &&
+           std::get<2>(stored.at(prefix)) == digests.at(prefix)) {
+        matched[prefix] = prefix;
+        prefix++;
+    }
+    int suffix = 0;
+    while (suffix < digests.size()-prefix && suffix < stored.size()-prefix &&
+           std::get<2>(stored.at(stored.size()-1-suffix)) == digests.at(digests.size()-1-suffix)) {
+        matched[digests.size()-1-suffix] = stored.size()-1-suffix;
+        suffix++;
+    }
 
-                auto column_define = kwdl.findTableViaTypeName(t_type).childAt(item->row());
-                switch (column_define.vType()) {
-                    case KeywordField::ValueType::NUMBER:
-                    case KeywordField::ValueType::STRING:
-                        item->setText(item->data().toString());
-                        break;
-                    case KeywordField::ValueType::ENUM:{
-                            auto values = kwdl.avaliableEnumsForIndex(item->index());
-                            auto item_index = item->data().toInt();
-                            if(item_index <0 || item_index>=values.size())
-                                throw new WsException("存储值超界");
-                            item->setText(values[item_index].second);
-                        }break;
-                    case KeywordField::ValueType::TABLEREF:{
-                            if(item->data().isNull()){
-                                item->setText("悬空");
-                            }
-                            else{
-                                auto qex = getStatement();
-                                qex.prepare("select name from "+column_define.supplyValue()+" where id=:id");
-                                qex.bindValue(":id", item->data());
-                                ExSqlQuery(qex);
-                                if(!qex.next())
-                                    throw new WsException("绑定空值");
-                                item->setText(qex.value(0).toString());
-                            }
-                        }break;
-                }
-            }
+    // 中段按摘要顺序贪婪匹配，限制跳跃窗口避免重复段落（如空行）错位
+    const int match_window = 64;
+    QHash<QByteArray, QList<int>> slots;
+    for (int index=prefix; index<stored.size()-suffix; ++index)
+        slots[std::get<2>(stored.at(index))] << index;
+
+    int last_stored = prefix - 1;
+    for (int index=prefix; index<digests.size()-suffix; ++index) {
+        auto &queue = slots[digests.at(index)];
+        while (queue.size() && queue.first() <= last_stored)
+            queue.removeFirst();
+        if(queue.isEmpty() || queue.first() - last_stored > match_window)
+            continue;
+
+        matched[index] = queue.takeFirst();
+        last_stored = matched[index];
     }
-}
 
+    // 分配order-key：新段落插入前后锚点之间，间隙不足时整体重排
+    QList<double> okeys;
+    bool renumber = false;
+    for (int index=0; index<digests.size() && !renumber;) {
+        if(matched.at(index) >= 0){
+            okeys << std::get<1>(stored.at(matched.at(index)));
+            index++;
+            continue;
+        }
 
+        int run_end = index;
+        while (run_end < digests.size() && matched.at(run_end) < 0)
+            run_end++;
 
+        double prev_key = okeys.size()?okeys.last():0;
+        double step = 1;
+        if(run_end < digests.size()){
+            auto next_key = std::get<1>(stored.at(matched.at(run_end)));
+            step = (next_key - prev_key) / (run_end - index + 1);
+        }
+        if(step < 1e-6){
+            renumber = true;
+            break;
+        }
 
+        for (int run_start = index; index<run_end; ++index)
+            okeys << prev_key + step * (index - run_start + 1);
+    }
+    if(renumber){
+        okeys.clear();
+        for (int index=0; index<digests.size(); ++index)
+            okeys << index + 1;
+    }
+
+    QSet<int> kept;
+    QVariantList update_ids, update_keys;
+    QVariantList insert_cids, insert_keys, insert_digests, insert_contents;
+    for (int index=0; index<digests.size(); ++index) {
+        if(matched.at(index) >= 0){
+            auto record = stored.at(matched.at(index));
+            kept << std::get<0>(record);
+            if(!qFuzzyCompare(std::get<1>(record), okeys.at(index))){
+                update_ids << std::get<0>(record);
+                update_keys << okeys.at(index);
+            }
+            continue;
+        }
 
+        insert_cids << chapter.uniqueID();
+        insert_keys << okeys.at(index);
+        insert_digests << digests.at(index);
+        insert_contents << paragraphs.at(index);
+    }
 
+    QVariantList remove_ids;
+    for (auto record : stored) {
+        if(!kept.contains(std::get<0>(record)))
+            remove_ids << std::get<0>(record);
+    }
 
+    if(remove_ids.size()){
+        sql.prepare("delete from paragraphs_collect where id = ?");
+        sql.addBindValue(remove_ids);
+        if(!sql.execBatch())
+            throw new WsException(sql.lastError().text());
+    }
+    if(update_ids.size()){
+        sql.prepare("update paragraphs_collect set okey = ? where id = ?");
+        sql.addBindValue(update_keys);
+        sql.addBindValue(update_ids);
+        if(!sql.execBatch())
+            throw new WsException(sql.lastError().text());
+    }
+    if(insert_cids.size()){
+        sql.prepare("insert into paragraphs_collect (chapter_ref, okey, digest, content) values(?, ?, ?, ?)");
+        sql.addBindValue(insert_cids);
+        sql.addBindValue(insert_keys);
+        sql.addBindValue(insert_digests);
+        sql.addBindValue(insert_contents);
+        if(!sql.execBatch())
+            throw new WsException(sql.lastError().text());
+    }
+}
+
+
+QString DBAccess::filePath() const
+{
+    return dbins.databaseName();
+}
+
+QSqlQuery DBAccess::getStatement() const
+{
+    return QSqlQuery(dbins);
+}
 
 void DBAccess::init_tables(QSqlDatabase &db)
 {
@@ -230,11 +463,460 @@ void DBAccess::init_tables(QSqlDatabase &db)
     }
 }
 
+// 修订清单格式：关键帧为完整段落摘要列表；增量帧为相对基础修订的COPY/ADD操作序列
+static const int revision_keyframe_interval = 16;
+enum class ManifestOp : quint8 { COPY = 0, ADD = 1 };
+
+static QByteArray _manifest_keyframe(const QList<QByteArray> &digests)
+{
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out << static_cast<quint32>(digests.size());
+    for (auto digest : digests)
+        out.writeRawData(digest.constData(), digest.size());
+    return bytes;
+}
+
+static QByteArray _manifest_delta(const QList<QByteArray> &base, const QList<QByteArray> &digests,
+                                  QList<int> &addedIndexes)
+{
+    QHash<QByteArray, int> first_position;
+    for (int index=base.size()-1; index>=0; --index)
+        first_position[base.at(index)] = index;
+
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    for (int index=0; index<digests.size();) {
+        auto digest = digests.at(index);
+        if(!first_position.contains(digest)){
+            out << static_cast<quint8>(ManifestOp::ADD);
+            out.writeRawData(digest.constData(), digest.size());
+            addedIndexes << index++;
+            continue;
+        }
+
+        quint32 start = static_cast<quint32>(first_position[digest]), length = 0;
+        while (index < digests.size() && static_cast<int>(start+length) < base.size() &&
+               base.at(static_cast<int>(start+length)) == digests.at(index)) {
+            length++;
+            index++;
+        }
+        out << static_cast<quint8>(ManifestOp::COPY) << start << length;
+    }
+    return bytes;
+}
+
+QList<QByteArray> DBAccess::_revision_manifest(int revisionID, int *depthOut) const
+{
+    auto sql = getStatement();
+    sql.prepare("select base_ref, depth, manifest from revisions_collect where id = :id");
+    sql.bindValue(":id", revisionID);
+    ExSqlQuery(sql);
+    if(!sql.next())
+        throw new WsException("指定修订不存在");
+
+    auto base_ref = sql.value(0);
+    if(depthOut)
+        *depthOut = sql.value(1).toInt();
+    auto manifest = sql.value(2).toByteArray();
+    QDataStream in(manifest);
+    const int digest_size = QCryptographicHash::hashLength(QCryptographicHash::Md5);
+
+    QList<QByteArray> digests;
+    if(base_ref.isNull()){
+        quint32 count;
+        in >> count;
+        for (quint32 index=0; index<count; ++index) {
+            QByteArray digest(digest_size, '\0');
+            in.readRawData(digest.data(), digest_size);
+            digests << digest;
+        }
+        return digests;
+    }
+
+    auto base = _revision_manifest(base_ref.toInt());
+    while (!in.atEnd()) {
+        quint8 op;
+        in >> op;
+        if(op == static_cast<quint8>(ManifestOp::COPY)){
+            quint32 start, length;
+            in >> start >> length;
+            digests.append(base.mid(static_cast<int>(start), static_cast<int>(length)));
+        }
+        else {
+            QByteArray digest(digest_size, '\0');
+            in.readRawData(digest.data(), digest_size);
+            digests << digest;
+        }
+    }
+    return digests;
+}
+
+void DBAccess::_collect_revision_chunks()
+{
+    // 差量清单的COPY段引用基准修订，基准随差量存续，故仅收集各清单自带的摘要即可
+    auto sql = getStatement();
+    sql.prepare("select base_ref, manifest from revisions_collect");
+    ExSqlQuery(sql);
+
+    const int digest_size = QCryptographicHash::hashLength(QCryptographicHash::Md5);
+    QSet<QByteArray> referenced;
+    while (sql.next()) {
+        auto keyframe = sql.value(0).isNull();
+        auto manifest = sql.value(1).toByteArray();
+        QDataStream in(manifest);
+
+        auto read_digest = [&]{
+            QByteArray digest(digest_size, '\0');
+            in.readRawData(digest.data(), digest_size);
+            referenced << digest;
+        };
+
+        if(keyframe){
+            quint32 count;
+            in >> count;
+            for (quint32 index=0; index<count; ++index)
+                read_digest();
+            continue;
+        }
+        while (!in.atEnd()) {
+            quint8 op;
+            in >> op;
+            if(op == static_cast<quint8>(ManifestOp::COPY)){
+                quint32 start, length;
+                in >> start >> length;
+            }
+            else {
+                read_digest();
+            }
+        }
+    }
+
+    sql.prepare("select digest from revision_chunks");
+    ExSqlQuery(sql);
+    QVariantList orphans;
+    while (sql.next()) {
+        auto digest = sql.value(0).toByteArray();
+        if(!referenced.contains(digest))
+            orphans << digest;
+    }
+    if(orphans.isEmpty())
+        return;
+
+    sql.prepare("delete from revision_chunks where digest = ?");
+    sql.addBindValue(orphans);
+    if(!sql.execBatch())
+        throw new WsException(sql.lastError().text());
+}
+
+void DBAccess::collectRevisionChunks()
+{
+    if(!revision_chunks_dirty)
+        return;
+
+    auto transaction_owned = dbins.transaction();
+    try {
+        _collect_revision_chunks();
+    } catch (WsException *e) {
+        if(transaction_owned)
+            dbins.rollback();
+        throw e;
+    }
+
+    if(transaction_owned && !dbins.commit())
+        throw new WsException(dbins.lastError().text());
+    revision_chunks_dirty = false;
+}
+
+void DBAccess::appendChapterRevision(const DBAccess::StoryTreeNode &chapter, const QString &text)
+{
+    if(chapter.type() != StoryTreeNode::Type::CHAPTER)
+        throw new WsException("指定节点非章节节点");
+
+    auto paragraphs = text.split("\n");
+    QList<QByteArray> digests;
+    for (auto para : paragraphs)
+        digests << _paragraph_digest(para);
+
+    auto sql = getStatement();
+    sql.prepare("select id from revisions_collect where chapter_ref = :cid order by stamp desc, id desc limit 1");
+    sql.bindValue(":cid", chapter.uniqueID());
+    ExSqlQuery(sql);
+
+    QVariant base_ref;
+    int depth = 0;
+    QList<int> added;
+    QByteArray manifest;
+    if(sql.next()){
+        int base_depth;
+        auto base = _revision_manifest(sql.value(0).toInt(), &base_depth);
+        if(base == digests)
+            return;
+
+        if(base_depth + 1 < revision_keyframe_interval){
+            base_ref = sql.value(0);
+            depth = base_depth + 1;
+            manifest = _manifest_delta(base, digests, added);
+        }
+    }
+    if(!base_ref.isValid()){
+        base_ref = QVariant(QVariant::Int);
+        manifest = _manifest_keyframe(digests);
+        for (int index=0; index<digests.size(); ++index)
+            added << index;
+    }
+
+    auto transaction_owned = dbins.transaction();
+    try {
+        if(added.size()){
+            QVariantList chunk_digests, chunk_contents;
+            QSet<QByteArray> filter;
+            for (auto index : added) {
+                if(filter.contains(digests.at(index)))
+                    continue;
+                filter << digests.at(index);
+                chunk_digests << digests.at(index);
+                chunk_contents << qCompress(paragraphs.at(index).toUtf8());
+            }
+
+            sql.prepare("insert or ignore into revision_chunks (digest, content) values(?, ?)");
+            sql.addBindValue(chunk_digests);
+            sql.addBindValue(chunk_contents);
+            if(!sql.execBatch())
+                throw new WsException(sql.lastError().text());
+        }
+
+        sql.prepare("insert into revisions_collect (chapter_ref, stamp, base_ref, depth, manifest) "
+                    "values(:cid, :stamp, :base, :depth, :mf)");
+        sql.bindValue(":cid", chapter.uniqueID());
+        sql.bindValue(":stamp", QDateTime::currentMSecsSinceEpoch());
+        sql.bindValue(":base", base_ref);
+        sql.bindValue(":depth", depth);
+        sql.bindValue(":mf", manifest);
+        ExSqlQuery(sql);
+    } catch (WsException *e) {
+        if(transaction_owned)
+            dbins.rollback();
+        throw e;
+    }
+
+    if(transaction_owned && !dbins.commit())
+        throw new WsException(dbins.lastError().text());
+}
+
+QList<QPair<int, QDateTime>> DBAccess::chapterRevisions(const DBAccess::StoryTreeNode &chapter,
+                                                         const QDateTime &from, const QDateTime &to) const
+{
+    if(chapter.type() != StoryTreeNode::Type::CHAPTER)
+        throw new WsException("指定节点非章节节点");
+
+    auto sql = getStatement();
+    sql.prepare("select id, stamp from revisions_collect where chapter_ref = :cid "
+                "and stamp >= :from and stamp <= :to order by stamp, id");
+    sql.bindValue(":cid", chapter.uniqueID());
+    sql.bindValue(":from", from.isValid()?from.toMSecsSinceEpoch():std::numeric_limits<qint64>::min());
+    sql.bindValue(":to", to.isValid()?to.toMSecsSinceEpoch():std::numeric_limits<qint64>::max());
+    ExSqlQuery(sql);
+
+    QList<QPair<int, QDateTime>> result;
+    while (sql.next())
+        result << qMakePair(sql.value(0).toInt(), QDateTime::fromMSecsSinceEpoch(sql.value(1).toLongLong()));
+
+    return result;
+}
+
+int DBAccess::chapterRevisionAt(const DBAccess::StoryTreeNode &chapter, const QDateTime &stamp) const
+{
+    if(chapter.type() != StoryTreeNode::Type::CHAPTER)
+        throw new WsException("指定节点非章节节点");
+
+    auto sql = getStatement();
+    sql.prepare("select id from revisions_collect where chapter_ref = :cid and stamp <= :stamp "
+                "order by stamp desc, id desc limit 1");
+    sql.bindValue(":cid", chapter.uniqueID());
+    sql.bindValue(":stamp", stamp.toMSecsSinceEpoch());
+    ExSqlQuery(sql);
+
+    if(sql.next())
+        return sql.value(0).toInt();
+    return -1;
+}
+
+QString DBAccess::revisionText(int revisionID) const
+{
+    auto digests = _revision_manifest(revisionID);
+
+    auto sql = getStatement();
+    sql.prepare("select content from revision_chunks where digest = :dg");
+
+    QHash<QByteArray, QString> chunks;
+    QStringList paragraphs;
+    for (auto digest : digests) {
+        if(!chunks.contains(digest)){
+            sql.bindValue(":dg", digest);
+            ExSqlQuery(sql);
+            if(!sql.next())
+                throw new WsException("修订数据块缺失");
+            chunks[digest] = QString::fromUtf8(qUncompress(sql.value(0).toByteArray()));
+        }
+        paragraphs << chunks[digest];
+    }
+
+    return paragraphs.join("\n");
+}
+
+void DBAccess::_load_schema_catalog() const
+{
+    if(schema_loaded)
+        return;
+
+    auto sql = getStatement();
+    sql.prepare("select id, type, parent, nindex, name, vtype, supply from tables_define order by parent, nindex");
+    ExSqlQuery(sql);
+
+    schema_catalog.clear();
+    schema_children.clear();
+    schema_root_id = INT_MAX;
+    while (sql.next()) {
+        auto id = sql.value(0).toInt();
+        SchemaEntry entry{sql.value(1).toInt(), sql.value(2).isNull()?INT_MAX:sql.value(2).toInt(), sql.value(3).toInt(),
+                    sql.value(4).toString(), sql.value(5).toInt(), sql.value(6).toString()};
+        schema_catalog.insert(id, entry);
+
+        if(entry.type == -1)
+            schema_root_id = id;
+        else
+            schema_children[entry.parent] << id;
+    }
+
+    schema_loaded = true;
+}
+
+const DBAccess::SchemaEntry &DBAccess::_schema_entry(int fieldID) const
+{
+    _load_schema_catalog();
+
+    auto it = schema_catalog.constFind(fieldID);
+    if(it == schema_catalog.constEnd())
+        throw new WsException("传入的节点无效");
+
+    return it.value();
+}
+
+void DBAccess::_invalidate_schema_catalog()
+{
+    schema_loaded = false;
+    schema_catalog.clear();
+    schema_children.clear();
+    _invalidate_keywords_records();
+}
+
+void DBAccess::_invalidate_keywords_records()
+{
+    keywords_records_cache.clear();
+    emit keywordsRecordsChanged();
+}
+
+void DBAccess::_invalidate_keyword_record(const QString &tableName, int id)
+{
+    keywords_records_cache.remove(qMakePair(tableName, id));
+    emit keywordRecordChanged(tableName, id);
+}
+
+void DBAccess::_ensure_extended_tables()
+{
+    QString statements[] = {
+        "create index if not exists keys_tree_children on keys_tree(parent, type, nindex)",
+
+        "create table if not exists paragraphs_collect("
+        "id integer primary key autoincrement,"
+        "chapter_ref integer not null,"
+        "okey real not null,"
+        "digest blob,"
+        "content text,"
+        "constraint fkpara foreign key(chapter_ref) references keys_tree(id) on delete cascade)",
+
+        "create index if not exists paragraphs_order on paragraphs_collect(chapter_ref, okey)",
+
+        "create table if not exists chapter_words("
+        "chapter_ref integer primary key,"
+        "words integer not null,"
+        "constraint fkwords foreign key(chapter_ref) references keys_tree(id) on delete cascade)",
+
+        "create table if not exists revision_chunks("
+        "digest blob primary key,"
+        "content blob not null)",
+
+        "create table if not exists revisions_collect("
+        "id integer primary key autoincrement,"
+        "chapter_ref integer not null,"
+        "stamp integer not null,"
+        "base_ref integer,"
+        "depth integer not null default 0,"
+        "manifest blob not null,"
+        "constraint fkrev foreign key(chapter_ref) references keys_tree(id) on delete cascade,"
+        "constraint fkbase foreign key(base_ref) references revisions_collect(id) on delete cascade)",
+
+        "create index if not exists revisions_order on revisions_collect(chapter_ref, stamp)"
+    };
+
+    auto q = getStatement();
+    for (auto statement : statements) {
+        if(!q.exec(statement))
+            throw new WsException(QString("扩展表格建立错误：%1").arg(q.lastError().text()));
+    }
+}
+
+static QStringList _keyword_grams(const QString &text, bool queryMode)
+{
+    auto lower = text.toLower();
+    QStringList grams;
+    if(!queryMode || lower.length() == 1){
+        for (auto ch : lower)
+            grams << QString(ch);
+    }
+    for (int index=0; index+1<lower.length(); ++index)
+        grams << lower.mid(index, 2);
+
+    return grams;
+}
+
+void DBAccess::_index_keyword(const QString &tableName, int id, const QString &name)
+{
+    _unindex_keyword(tableName, id);
+
+    keywords_name_index[tableName][id] = name;
+    auto &grams_index = keywords_ngram_index[tableName];
+    for (auto gram : _keyword_grams(name, false))
+        grams_index[gram] << id;
+}
+
+void DBAccess::_unindex_keyword(const QString &tableName, int id)
+{
+    auto &names = keywords_name_index[tableName];
+    if(!names.contains(id))
+        return;
+
+    auto &grams_index = keywords_ngram_index[tableName];
+    for (auto gram : _keyword_grams(names.take(id), false)) {
+        auto it = grams_index.find(gram);
+        if(it == grams_index.end())
+            continue;
+
+        it.value().remove(id);
+        if(it.value().isEmpty())
+            grams_index.erase(it);
+    }
+}
+
 void DBAccess::_push_all_keywords_to_confighost()
 {
     KeywordController handle(*this);
     auto sql = getStatement();
+    keywords_ngram_index.clear();
+    keywords_name_index.clear();
 
+    QList<std::tuple<QString, int, QString>> keywords;
     auto table = handle.firstTable();
     while (table.isValid()) {
         auto real_tablename = table.tableName();
@@ -242,11 +924,13 @@ void DBAccess::_push_all_keywords_to_confighost()
         ExSqlQuery(sql);
 
         while (sql.next()) {
-            config_host.appendKeyword(real_tablename, sql.value(0).toInt(), sql.value(1).toString());
+            keywords << std::make_tuple(real_tablename, sql.value(0).toInt(), sql.value(1).toString());
+            _index_keyword(real_tablename, sql.value(0).toInt(), sql.value(1).toString());
         }
 
         table = table.nextSibling();
     }
+    config_host.appendKeywords(keywords);
 }
 
 
@@ -389,8 +1073,7 @@ bool DBAccess::KeywordField::isTableDefine() const
     if(!valid_state)
         return valid_state;
 
-    KeywordController hdl(*host);
-    return hdl.defRoot().registID() == parent().registID();
+    return host->_schema_entry(field_id_store).type == 0;
 }
 
 bool DBAccess::KeywordField::isValid() const{return valid_state;}
@@ -469,6 +1152,11 @@ DBAccess::StoryTreeNode DBAccess::StoryTreeController::novelNode() const
     return StoryTreeNode();
 }
 
+DBAccess::StoryTreeNode DBAccess::StoryTreeController::nodeOf(int id, DBAccess::StoryTreeNode::Type type) const
+{
+    return StoryTreeNode(&host, id, type);
+}
+
 QString DBAccess::StoryTreeController::titleOf(const DBAccess::StoryTreeNode &node) const
 {
     auto sql = host.getStatement();
@@ -581,16 +1269,43 @@ void DBAccess::StoryTreeController::removeNode(const DBAccess::StoryTreeNode &no
     auto index = indexOf(node);
     auto type = node.type();
 
-    auto sql = host.getStatement();
-    sql.prepare("update keys_tree set nindex=nindex-1 where parent=:pid and nindex>=:index and type=:type");
-    sql.bindValue(":pid", pnode.uniqueID());
-    sql.bindValue(":index", index);
-    sql.bindValue(":type", static_cast<int>(type));
-    ExSqlQuery(sql);
+    auto transaction_owned = host.dbins.transaction();
+    try {
+        auto sql = host.getStatement();
+        sql.prepare("update keys_tree set nindex=nindex-1 where parent=:pid and nindex>=:index and type=:type");
+        sql.bindValue(":pid", pnode.uniqueID());
+        sql.bindValue(":index", index);
+        sql.bindValue(":type", static_cast<int>(type));
+        ExSqlQuery(sql);
 
-    sql.prepare("delete from keys_tree where id=:id");
-    sql.bindValue(":id", node.uniqueID());
-    ExSqlQuery(sql);
+        // 子树关联数据整体删除，避免逐行级联
+        const QString subtree = "with recursive subtree(id) as (select :id union all "
+                                "select k.id from keys_tree k inner join subtree s on k.parent=s.id) ";
+        QStringList statements;
+        statements << "delete from contents_collect where chapter_ref in (select id from subtree)"
+                   << "delete from paragraphs_collect where chapter_ref in (select id from subtree)"
+                   << "delete from chapter_words where chapter_ref in (select id from subtree)"
+                   << "delete from revisions_collect where chapter_ref in (select id from subtree)"
+                   << "delete from points_collect where despline_ref in (select id from subtree) "
+                      "or chapter_attached in (select id from subtree) or story_attached in (select id from subtree)"
+                   << "delete from keys_tree where id in (select id from subtree)";
+        for (auto statement : statements) {
+            sql.prepare(subtree + statement);
+            sql.bindValue(":id", node.uniqueID());
+            ExSqlQuery(sql);
+        }
+    } catch (WsException *e) {
+        if(transaction_owned)
+            host.dbins.rollback();
+        throw e;
+    }
+
+    if(transaction_owned && !host.dbins.commit())
+        throw new WsException(host.dbins.lastError().text());
+
+    // 章节修订随之删除，失去引用的数据块留待collectRevisionChunks回收，删除本身不解码清单
+    if(type == StoryTreeNode::Type::VOLUME || type == StoryTreeNode::Type::CHAPTER)
+        host.revision_chunks_dirty = true;
 }
 
 DBAccess::StoryTreeNode DBAccess::StoryTreeController::insertChildNodeBefore(const DBAccess::StoryTreeNode &pnode, DBAccess::StoryTreeNode::Type type,
@@ -656,6 +1371,114 @@ DBAccess::StoryTreeNode DBAccess::StoryTreeController::getNodeViaID(int id) cons
     return StoryTreeNode(&host, id, static_cast<StoryTreeNode::Type>(sql.value(0).toInt()));
 }
 
+QList<QPair<QString, int> > DBAccess::StoryTreeController::desplinesUntil(const DBAccess::StoryTreeNode &volume) const
+{
+    auto sql = host.getStatement();
+    sql.prepare("select d.title, d.id from keys_tree d inner join keys_tree v on d.parent=v.id "
+                "where d.type=:dtype and v.type=:vtype and v.nindex<=(select nindex from keys_tree where id=:vol) "
+                "order by v.nindex, d.nindex");
+    sql.bindValue(":dtype", static_cast<int>(StoryTreeNode::Type::DESPLINE));
+    sql.bindValue(":vtype", static_cast<int>(StoryTreeNode::Type::VOLUME));
+    sql.bindValue(":vol", volume.uniqueID());
+    ExSqlQuery(sql);
+
+    QList<QPair<QString, int>> ret;
+    while (sql.next())
+        ret << qMakePair(sql.value(0).toString(), sql.value(1).toInt());
+    return ret;
+}
+
+QList<int> DBAccess::StoryTreeController::chapterSequence() const
+{
+    auto sql = host.getStatement();
+    sql.prepare("select c.id from keys_tree c inner join keys_tree v on c.parent=v.id "
+                "where c.type=:ctype and v.type=:vtype order by v.nindex, c.nindex");
+    sql.bindValue(":ctype", static_cast<int>(StoryTreeNode::Type::CHAPTER));
+    sql.bindValue(":vtype", static_cast<int>(StoryTreeNode::Type::VOLUME));
+    ExSqlQuery(sql);
+
+    QList<int> ret;
+    while (sql.next())
+        ret << sql.value(0).toInt();
+    return ret;
+}
+
+QVector<DBAccess::StoryTreeController::SkeletonNode> DBAccess::StoryTreeController::navigateSkeleton() const
+{
+    // 类型取值恰为层级次序：卷宗(0)先于章节(1)、剧情(2)，剧情先于分解点(3)
+    auto sql = host.getStatement();
+    sql.prepare("select id, type, parent, title from keys_tree where type>=:vtype and type<=:ktype "
+                "order by type, parent, nindex");
+    sql.bindValue(":vtype", static_cast<int>(StoryTreeNode::Type::VOLUME));
+    sql.bindValue(":ktype", static_cast<int>(StoryTreeNode::Type::KEYPOINT));
+    ExSqlQuery(sql);
+
+    QVector<SkeletonNode> ret;
+    while (sql.next()) {
+        ret << SkeletonNode{sql.value(0).toInt(), static_cast<StoryTreeNode::Type>(sql.value(1).toInt()),
+                sql.value(2).toInt(), sql.value(3).toString()};
+    }
+    return ret;
+}
+
+QHash<int, QString> DBAccess::StoryTreeController::descriptionsUnder(const DBAccess::StoryTreeNode &pnode) const
+{
+    auto sql = host.getStatement();
+    sql.prepare("with recursive subtree(id) as (select :pid union all "
+                "select k.id from keys_tree k inner join subtree s on k.parent=s.id) "
+                "select id, desp from keys_tree where id in (select id from subtree)");
+    sql.bindValue(":pid", pnode.uniqueID());
+    ExSqlQuery(sql);
+
+    QHash<int, QString> ret;
+    while (sql.next())
+        ret.insert(sql.value(0).toInt(), sql.value(1).toString());
+    return ret;
+}
+
+void DBAccess::StoryTreeController::removeImpactOf(const DBAccess::StoryTreeNode &target, QList<QPair<int, QString> > &desplines,
+                                                   QList<DBAccess::StoryTreeController::PointImpact> &points) const
+{
+    const QString subtree = "with recursive subtree(id) as (select :target union all "
+                            "select k.id from keys_tree k inner join subtree s on k.parent=s.id) ";
+
+    auto sql = host.getStatement();
+    sql.prepare(subtree + "select id, title from keys_tree where type=:dtype and id in (select id from subtree) "
+                          "order by parent, nindex");
+    sql.bindValue(":target", target.uniqueID());
+    sql.bindValue(":dtype", static_cast<int>(StoryTreeNode::Type::DESPLINE));
+    ExSqlQuery(sql);
+    while (sql.next())
+        desplines << qMakePair(sql.value(0).toInt(), sql.value(1).toString());
+
+    sql.prepare(subtree + "select p.id, p.despline_ref, d.title, p.chapter_attached, c.title, p.story_attached, b.title, "
+                          "p.despline_ref in (select id from subtree), "
+                          "ifnull(p.chapter_attached in (select id from subtree), 0), "
+                          "ifnull(p.story_attached in (select id from subtree), 0) "
+                          "from points_collect p inner join keys_tree d on p.despline_ref=d.id "
+                          "left join keys_tree c on p.chapter_attached=c.id "
+                          "left join keys_tree b on p.story_attached=b.id "
+                          "where p.despline_ref in (select id from subtree) or p.chapter_attached in (select id from subtree) "
+                          "or p.story_attached in (select id from subtree) "
+                          "order by p.despline_ref, p.nindex");
+    sql.bindValue(":target", target.uniqueID());
+    ExSqlQuery(sql);
+    while (sql.next()) {
+        PointImpact impact;
+        impact.point_id = sql.value(0).toInt();
+        impact.despline_id = sql.value(1).toInt();
+        impact.despline_title = sql.value(2).toString();
+        impact.chapter_id = sql.value(3).isNull()? -1 : sql.value(3).toInt();
+        impact.chapter_title = sql.value(4).toString();
+        impact.storyblock_id = sql.value(5).isNull()? -1 : sql.value(5).toInt();
+        impact.storyblock_title = sql.value(6).toString();
+        impact.despline_removed = sql.value(7).toBool();
+        impact.chapter_removed = sql.value(8).toBool();
+        impact.storyblock_removed = sql.value(9).toBool();
+        points << impact;
+    }
+}
+
 DBAccess::BranchAttachController::BranchAttachController(DBAccess &host):host(host){}
 
 DBAccess::BranchAttachPoint DBAccess::BranchAttachController::getPointViaID(int id) const
@@ -908,44 +1731,67 @@ bool DBAccess::BranchAttachController::moveDownOf(const DBAccess::BranchAttachPo
     return true;
 }
 
-DBAccess::KeywordController::KeywordController(DBAccess &host):host(host){}
-
-DBAccess::KeywordField DBAccess::KeywordController::defRoot() const
+QList<QPair<QString, int> > DBAccess::BranchAttachController::pointsSummaryOf(const DBAccess::StoryTreeNode &despline,
+                                                                             DBAccess::StoryTreeNode::Type attachType,
+                                                                             const DBAccess::StoryTreeNode &attached) const
 {
+    QString column;
+    switch (attachType) {
+        case StoryTreeNode::Type::CHAPTER:
+            column = "chapter_attached";
+            break;
+        case StoryTreeNode::Type::STORYBLOCK:
+            column = "story_attached";
+            break;
+        default:
+            throw new WsException("驻点吸附类别错误");
+    }
+
     auto sql = host.getStatement();
-    sql.prepare("select id from tables_define where type=-1");
+    if(attached.isValid()){
+        sql.prepare(QString("select title, id from points_collect where despline_ref=:ref and %1=:target "
+                            "order by nindex").arg(column));
+        sql.bindValue(":target", attached.uniqueID());
+    }
+    else {
+        sql.prepare(QString("select title, id from points_collect where despline_ref=:ref and %1 is null "
+                            "order by nindex").arg(column));
+    }
+    sql.bindValue(":ref", despline.uniqueID());
     ExSqlQuery(sql);
 
-    if(!sql.next())
-        throw new WsException("未找到表格根节点");
-
-    return KeywordField(&host, sql.value(0).toInt());
+    QList<QPair<QString, int>> ret;
+    while (sql.next())
+        ret << qMakePair(sql.value(0).toString(), sql.value(1).toInt());
+    return ret;
 }
 
-int DBAccess::KeywordController::childCountOf(const DBAccess::KeywordField &pnode) const
+DBAccess::KeywordController::KeywordController(DBAccess &host):host(host){}
+
+DBAccess::KeywordField DBAccess::KeywordController::defRoot() const
 {
-    auto sql = host.getStatement();
-    sql.prepare("select count(*) from tables_define where parent=:pnode group by parent");
-    sql.bindValue(":pnode", pnode.registID());
-    ExSqlQuery(sql);
+    host._load_schema_catalog();
+    if(host.schema_root_id == INT_MAX)
+        throw new WsException("未找到表格根节点");
 
-    if(!sql.next())
-        return 0;
-    return sql.value(0).toInt();
+    return KeywordField(&host, host.schema_root_id);
+}
+
+int DBAccess::KeywordController::childCountOf(const DBAccess::KeywordField &pnode) const
+{
+    host._load_schema_catalog();
+    return host.schema_children.value(pnode.registID()).size();
 }
 
 DBAccess::KeywordField DBAccess::KeywordController::childFieldOf(const DBAccess::KeywordField &pnode, int index) const
 {
-    auto sql = host.getStatement();
-    sql.prepare("select id from tables_define where parent=:pnode and nindex=:idx");
-    sql.bindValue(":pnode", pnode.registID());
-    sql.bindValue(":idx", index);
-    ExSqlQuery(sql);
-
-    if(!sql.next())
-        return KeywordField();
+    host._load_schema_catalog();
+    for (auto id : host.schema_children.value(pnode.registID())) {
+        if(host.schema_catalog.value(id).index == index)
+            return KeywordField(&host, id);
+    }
 
-    return KeywordField(&host, sql.value(0).toInt());
+    return KeywordField();
 }
 
 DBAccess::KeywordField DBAccess::KeywordController::newTable(const QString &typeName)
@@ -971,6 +1817,7 @@ DBAccess::KeywordField DBAccess::KeywordController::newTable(const QString &type
     sql.bindValue(":name", typeName);
     sql.bindValue(":spy", new_table_name);
     ExSqlQuery(sql);
+    host._invalidate_schema_catalog();
 
     // 数据返回
     auto tdef = findTableViaTypeName(typeName);
@@ -997,6 +1844,7 @@ void DBAccess::KeywordController::tableForward(const DBAccess::KeywordField &nod
     sql.bindValue(":idx", index_lock-1);
     sql.bindValue(":id", node.registID());
     ExSqlQuery(sql);
+    host._invalidate_schema_catalog();
 }
 
 void DBAccess::KeywordController::tableBackward(const DBAccess::KeywordField &node)
@@ -1018,6 +1866,7 @@ void DBAccess::KeywordController::tableBackward(const DBAccess::KeywordField &no
     sql.bindValue(":idx", index_lock+1);
     sql.bindValue(":id", node.registID());
     ExSqlQuery(sql);
+    host._invalidate_schema_catalog();
 }
 
 void DBAccess::KeywordController::removeTable(const KeywordField &tbColumn)
@@ -1035,14 +1884,18 @@ void DBAccess::KeywordController::removeTable(const KeywordField &tbColumn)
     auto sql = host.getStatement();
     sql.prepare("drop table if exists "+ detail_table_ref);
     ExSqlQuery(sql);
+    host.keywords_ngram_index.remove(detail_table_ref);
+    host.keywords_name_index.remove(detail_table_ref);
 
     sql.prepare("update tables_define set nindex = nindex-1 where nindex>=:idx and type=0");
     sql.bindValue(":idx", index);
     ExSqlQuery(sql);
+    host._invalidate_schema_catalog();
 
     sql.prepare("delete from tables_define where id=:idx");
     sql.bindValue(":idx", tableDefineRow.registID());
     ExSqlQuery(sql);
+    host._invalidate_schema_catalog();
 }
 
 DBAccess::KeywordField DBAccess::KeywordController::firstTable() const
@@ -1052,27 +1905,39 @@ DBAccess::KeywordField DBAccess::KeywordController::firstTable() const
 
 DBAccess::KeywordField DBAccess::KeywordController::findTableViaTypeName(const QString &typeName) const
 {
-    auto sql = host.getStatement();
-    sql.prepare("select id from tables_define where type = 0 and name=:nm");
-    sql.bindValue(":nm", typeName);
-    ExSqlQuery(sql);
-    if(sql.next())
-        return KeywordField(&host, sql.value(0).toInt());
+    host._load_schema_catalog();
+    for (auto id : host.schema_children.value(host.schema_root_id)) {
+        if(host.schema_catalog.value(id).name == typeName)
+            return KeywordField(&host, id);
+    }
     return KeywordField();
 }
 
 DBAccess::KeywordField DBAccess::KeywordController::findTableViaTableName(const QString &tableName) const
 {
-    auto sql = host.getStatement();
-    sql.prepare("select id from tables_define where type=0 and supply=:spy");
-    sql.bindValue(":spy", tableName);
-    ExSqlQuery(sql);
-
-    if(sql.next())
-        return KeywordField(&host, sql.value(0).toInt());
+    host._load_schema_catalog();
+    for (auto id : host.schema_children.value(host.schema_root_id)) {
+        if(host.schema_catalog.value(id).supply == tableName)
+            return KeywordField(&host, id);
+    }
     return KeywordField();
 }
 
+static QString _keyword_column_define(int index, DBAccess::KeywordField::ValueType type, const QString &supply)
+{
+    switch (type) {
+        case DBAccess::KeywordField::ValueType::NUMBER:
+            return QString("field_%1 real").arg(index);
+        case DBAccess::KeywordField::ValueType::STRING:
+            return QString("field_%1 text").arg(index);
+        case DBAccess::KeywordField::ValueType::ENUM:
+            return QString("field_%1 integer").arg(index);
+        case DBAccess::KeywordField::ValueType::TABLEREF:
+            return QString("field_%1 integer references %2(id) on delete set null").arg(index).arg(supply);
+    }
+    return QString("field_%1").arg(index);
+}
+
 void DBAccess::KeywordController::tablefieldsAdjust(const KeywordField &target_table,
                                                     const QList<QPair<DBAccess::KeywordField,
                                                     std::tuple<QString, QString, DBAccess::KeywordField::ValueType>>> &_define)
@@ -1080,108 +1945,134 @@ void DBAccess::KeywordController::tablefieldsAdjust(const KeywordField &target_t
     if(!target_table.isTableDefine())
         throw new WsException("传入字段定义非表定义");
 
-    auto sql = host.getStatement();
-    // 关闭外键校验
-    sql.prepare("PRAGMA foreign_keys = OFF");
-    ExSqlQuery(sql);
-
-    // 数据转移
-    auto temp_values_table_name = target_table.tableName()+"____ws_transfer_table_delate_soon";
-    sql.prepare("create table "+temp_values_table_name+" as select * from "+target_table.tableName());
-    ExSqlQuery(sql);
-
+    const auto table_name = target_table.tableName();
+    const auto old_count = target_table.childCount();
 
-    // 组装最后的数据中转语句
-    QString select_data = "select name,";
-    QString insert_data = "insert into %1 (name,";
-    for (auto index=0; index<_define.size(); ++index) {
+    // 原有字段保持位置与类型(引用目标)不变时，只需在表尾增删列
+    auto column_unchanged = [&](int index){
         auto base_one = _define.at(index).first;
-        if(!base_one.isValid())
-            continue;
-
-        select_data += QString("field_%1,").arg(base_one.index());
-        insert_data += QString("field_%1,").arg(index);
+        auto custom_one = _define.at(index).second;
+        if(!base_one.isValid() || base_one.index() != index || base_one.vType() != std::get<2>(custom_one))
+            return false;
+        return std::get<2>(custom_one) != KeywordField::ValueType::TABLEREF ||
+                base_one.supplyValue() == std::get<1>(custom_one);
+    };
+    bool tail_only = true;
+    for (auto index=0; index<_define.size() && tail_only; ++index) {
+        if(index < old_count)
+            tail_only = column_unchanged(index);
+        else
+            tail_only = !_define.at(index).first.isValid();
     }
-    insert_data = insert_data.mid(0, insert_data.length()-1) + ")";
-    insert_data += select_data.mid(0, select_data.length()-1) + " from " + temp_values_table_name;
 
-    // 删除已建立关键词表格
-    sql.prepare("drop table if exists "+ target_table.tableName());
-    ExSqlQuery(sql);
-
-    // 清空字段记录
-    sql.prepare("delete from tables_define where type=1 and parent=:pnode");
-    sql.bindValue(":pnode", target_table.registID());
-    ExSqlQuery(sql);
-
-
-    //=========================
-    // target_table_name : table_name
-    // table_define : table_instance
+    auto sql = host.getStatement();
+    // DROP COLUMN 需要SQLite 3.35，且不能作用于外键列
+    if(tail_only && _define.size() < old_count){
+        sql.prepare("select sqlite_version()");
+        ExSqlQuery(sql);
+        sql.next();
+        auto version = sql.value(0).toString().split(".");
+        tail_only = version.size() >= 2 && (version[0].toInt() > 3 || (version[0].toInt() == 3 && version[1].toInt() >= 35));
 
+        for (auto index=_define.size(); index<old_count && tail_only; ++index)
+            tail_only = target_table.childAt(index).vType() != KeywordField::ValueType::TABLEREF;
+    }
 
-    // 插入自定义字段
-    sql.prepare("insert into tables_define (type, parent, nindex, name, vtype, supply) values(1, ?, ?, ?, ?, ?)");
-    QVariantList parentlist, indexlist, namelist, valuetypelist, supplyvaluelist;
-    for (auto index=0; index<_define.size(); ++index) {
-        auto custom_one = _define.at(index).second;
-        parentlist << target_table.registID();
-        indexlist << index;
-        namelist << std::get<0>(custom_one);
-        valuetypelist << static_cast<int>(std::get<2>(custom_one));
-        supplyvaluelist << std::get<1>(custom_one);
-    }
-    sql.addBindValue(parentlist);
-    sql.addBindValue(indexlist);
-    sql.addBindValue(namelist);
-    sql.addBindValue(valuetypelist);
-    sql.addBindValue(supplyvaluelist);
-    if(!sql.execBatch())
-        throw new WsException(sql.lastError().text());
+    // 重建表格期间关闭外键校验，须在事务之外设置
+    if(!tail_only){
+        sql.prepare("PRAGMA foreign_keys = OFF");
+        ExSqlQuery(sql);
+    }
 
+    auto transaction_owned = host.dbins.transaction();
+    try {
+        if(tail_only){
+            for (auto index=old_count; index<_define.size(); ++index) {
+                auto custom_one = _define.at(index).second;
+                sql.prepare("alter table " + table_name + " add column " +
+                            _keyword_column_define(index, std::get<2>(custom_one), std::get<1>(custom_one)));
+                ExSqlQuery(sql);
+            }
+            for (auto index=old_count-1; index>=_define.size(); --index) {
+                sql.prepare(QString("alter table %1 drop column field_%2").arg(table_name).arg(index));
+                ExSqlQuery(sql);
+            }
+        }
+        else {
+            // 新建表格 -> 数据转移 -> 删除旧表 -> 新表改名
+            auto rebuild_table_name = table_name + "__ws_rebuild";
+            sql.prepare("drop table if exists " + rebuild_table_name);
+            ExSqlQuery(sql);
+
+            QString create_table = "create table " + rebuild_table_name + " (id integer primary key autoincrement, name text";
+            QString select_data = "select id, name", insert_data = "insert into " + rebuild_table_name + " (id, name";
+            for (auto index=0; index<_define.size(); ++index) {
+                auto custom_one = _define.at(index).second;
+                create_table += ", " + _keyword_column_define(index, std::get<2>(custom_one), std::get<1>(custom_one));
+
+                auto base_one = _define.at(index).first;
+                if(!base_one.isValid())
+                    continue;
+                select_data += QString(", field_%1").arg(base_one.index());
+                insert_data += QString(", field_%1").arg(index);
+            }
 
-    // 重建关键词表格
-    QString create_table = "create table "+ target_table.tableName() +" (" +
-                           "id integer primary key autoincrement, name text,",
-            constraint = "";
+            sql.prepare(create_table + ")");
+            ExSqlQuery(sql);
+            sql.prepare(insert_data + ") " + select_data + " from " + table_name);
+            ExSqlQuery(sql);
+            sql.prepare("drop table " + table_name);
+            ExSqlQuery(sql);
+            sql.prepare("alter table " + rebuild_table_name + " rename to " + table_name);
+            ExSqlQuery(sql);
+
+            sql.prepare("PRAGMA foreign_key_check(" + table_name + ")");
+            ExSqlQuery(sql);
+            if(sql.next())
+                throw new WsException("表格重建后外键校验失败："+table_name);
+        }
 
-    for (auto index=0; index<_define.size(); ++index) {
-        auto custom_one = _define.at(index).second;
-        switch (std::get<2>(custom_one)) {
-            case KeywordField::ValueType::NUMBER:{
-                    create_table += QString("field_%1 real,").arg(index);
-                }break;
-            case KeywordField::ValueType::STRING:{
-                    create_table += QString("field_%1 text,").arg(index);
-                }break;
-            case KeywordField::ValueType::ENUM:{
-                    create_table += QString("field_%1 integer,").arg(index);
-                }break;
-            case KeywordField::ValueType::TABLEREF:{
-                    create_table += QString("field_%1 integer,").arg(index);
-                    constraint += QString("constraint fk_%1 foreign key(field_%1) references %2(id) on delete set null,")
-                                  .arg(index).arg(std::get<1>(custom_one));
-                }break;
+        // 重写字段记录
+        sql.prepare("delete from tables_define where type=1 and parent=:pnode");
+        sql.bindValue(":pnode", target_table.registID());
+        ExSqlQuery(sql);
+        host._invalidate_schema_catalog();
+
+        if(_define.size()){
+            sql.prepare("insert into tables_define (type, parent, nindex, name, vtype, supply) values(1, ?, ?, ?, ?, ?)");
+            QVariantList parentlist, indexlist, namelist, valuetypelist, supplyvaluelist;
+            for (auto index=0; index<_define.size(); ++index) {
+                auto custom_one = _define.at(index).second;
+                parentlist << target_table.registID();
+                indexlist << index;
+                namelist << std::get<0>(custom_one);
+                valuetypelist << static_cast<int>(std::get<2>(custom_one));
+                supplyvaluelist << std::get<1>(custom_one);
+            }
+            sql.addBindValue(parentlist);
+            sql.addBindValue(indexlist);
+            sql.addBindValue(namelist);
+            sql.addBindValue(valuetypelist);
+            sql.addBindValue(supplyvaluelist);
+            if(!sql.execBatch())
+                throw new WsException(sql.lastError().text());
+            host._invalidate_schema_catalog();
         }
+    } catch (WsException *e) {
+        if(transaction_owned)
+            host.dbins.rollback();
+        host._invalidate_schema_catalog();
+        if(!tail_only)
+            sql.exec("PRAGMA foreign_keys = ON");
+        throw e;
     }
 
-    create_table += constraint;
-    create_table = create_table.mid(0, create_table.length()-1);
-    create_table += ")";
-
-    sql.prepare(create_table);
-    ExSqlQuery(sql);
-
-
-    // 数据转移
-    insert_data = insert_data.arg(target_table.tableName());
-    sql.prepare(insert_data);
-    ExSqlQuery(sql);
-
-    sql.prepare("drop table "+temp_values_table_name);
-    ExSqlQuery(sql);
-
-    sql.exec("PRAGMA foreign_keys = ON");
+    if(transaction_owned && !host.dbins.commit()){
+        host._invalidate_schema_catalog();
+        throw new WsException(host.dbins.lastError().text());
+    }
+    if(!tail_only)
+        sql.exec("PRAGMA foreign_keys = ON");
 }
 
 QString DBAccess::KeywordController::tableNameOf(const DBAccess::KeywordField &colDef) const
@@ -1198,36 +2089,17 @@ int DBAccess::KeywordController::indexOf(const DBAccess::KeywordField &colDef) c
     if(!colDef.isValid())
         throw new WsException("传入的节点无效");
 
-    auto sql = host.getStatement();
-    sql.prepare("select nindex from tables_define where id=:id");
-    sql.bindValue(":id", colDef.registID());
-    ExSqlQuery(sql);
-    if(sql.next())
-        return sql.value(0).toInt();
-
-    throw new WsException("传入的节点无效");
+    return host._schema_entry(colDef.registID()).index;
 }
 
 DBAccess::KeywordField::ValueType DBAccess::KeywordController::valueTypeOf(const DBAccess::KeywordField &colDef) const
 {
-    auto sql = host.getStatement();
-    sql.prepare("select vtype from tables_define where id=:id");
-    sql.bindValue(":id", colDef.registID());
-    ExSqlQuery(sql);
-    if(sql.next())
-        return static_cast<DBAccess::KeywordField::ValueType>(sql.value(0).toInt());
-    throw new WsException("传入的节点无效");
+    return static_cast<DBAccess::KeywordField::ValueType>(host._schema_entry(colDef.registID()).vtype);
 }
 
 QString DBAccess::KeywordController::nameOf(const DBAccess::KeywordField &colDef) const
 {
-    auto sql = host.getStatement();
-    sql.prepare("select name from tables_define where id=:id");
-    sql.bindValue(":id", colDef.registID());
-    ExSqlQuery(sql);
-    if(sql.next())
-        return sql.value(0).toString();
-    throw new WsException("传入的节点无效");
+    return host._schema_entry(colDef.registID()).name;
 }
 
 void DBAccess::KeywordController::resetNameOf(const DBAccess::KeywordField &col, const QString &name)
@@ -1242,26 +2114,22 @@ void DBAccess::KeywordController::resetNameOf(const DBAccess::KeywordField &col,
     sql.bindValue(":nm", name);
     sql.bindValue(":id", col.registID());
     ExSqlQuery(sql);
+    host._invalidate_schema_catalog();
 }
 
 QString DBAccess::KeywordController::supplyValueOf(const DBAccess::KeywordField &field) const
 {
-    auto sql = host.getStatement();
-    sql.prepare("select supply from tables_define where id=:id");
-    sql.bindValue(":id", field.registID());
-    ExSqlQuery(sql);
-    if(sql.next())
-        return sql.value(0).toString();
-    throw new WsException("传入的节点无效");
+    return host._schema_entry(field.registID()).supply;
 }
 
 void DBAccess::KeywordController::resetSupplyValueOf(const DBAccess::KeywordField &field, const QString &supply)
 {
     auto sql = host.getStatement();
-    sql.prepare("update tables_define set supply=:syp where id=:id");
+    sql.prepare("update tables_define set supply=:spy where id=:id");
     sql.bindValue(":id", field.registID());
     sql.bindValue(":spy", supply);
     ExSqlQuery(sql);
+    host._invalidate_schema_catalog();
 }
 
 DBAccess::KeywordField DBAccess::KeywordController::parentOf(const DBAccess::KeywordField &field) const
@@ -1269,14 +2137,7 @@ DBAccess::KeywordField DBAccess::KeywordController::parentOf(const DBAccess::Key
     if(field.registID() == defRoot().registID())
         return KeywordField();
 
-    auto sql = host.getStatement();
-    sql.prepare("select type, parent from tables_define where id=:id");
-    sql.bindValue(":id", field.registID());
-    ExSqlQuery(sql);
-
-    if(!sql.next())
-        throw new WsException("指定传入节点无效");
-    return KeywordField(&host, sql.value(1).toInt());
+    return KeywordField(&host, host._schema_entry(field.registID()).parent);
 }
 
 int DBAccess::KeywordController::fieldsCountOf(const DBAccess::KeywordField &table) const
@@ -1318,129 +2179,356 @@ DBAccess::KeywordField DBAccess::KeywordController::previousSiblingOf(const DBAc
 
 
 
-void DBAccess::KeywordController::queryKeywordsLike(QStandardItemModel *disp_model, const QString &queryWord,
-                                                    const DBAccess::KeywordField &table) const
+void DBAccess::KeywordController::appendEmptyItemAt(const DBAccess::KeywordField &table, const QString &name)
 {
-    host.disconnect_listen_connect(disp_model);
-    disp_model->clear();
-    if(queryWord.isEmpty()) return;
+    auto sql = host.getStatement();
+    sql.prepare("insert into "+table.tableName()+" (name) values (:nm)");
+    sql.bindValue(":nm", name);
+    ExSqlQuery(sql);
+
+    sql.prepare("select id from "+table.tableName()+ " where name=:nm order by id desc");
+    sql.bindValue(":nm", name);
+    ExSqlQuery(sql);
+
+    if(!sql.next())
+        throw new WsException("插入新条目失败！");
+
+    auto id = sql.value(0).toInt();
+    host.config_host.appendKeyword(table.tableName(), id, name);
+    host._index_keyword(table.tableName(), id, name);
+    host._invalidate_keyword_record(table.tableName(), id);
+}
 
+void DBAccess::KeywordController::resetKeywordNameOf(const DBAccess::KeywordField &table, int itemID, const QString &name)
+{
     auto sql = host.getStatement();
-    auto table_define = table;
-    if(!table_define.isTableDefine())
-        table_define = table_define.parent();
+    sql.prepare("update "+table.tableName()+" set name=:nm where id=:id");
+    sql.bindValue(":nm", name);
+    sql.bindValue(":id", itemID);
+    ExSqlQuery(sql);
 
-    disp_model->setHorizontalHeaderLabels(QStringList()<<"名称"<<"数据");
+    host.config_host.appendKeyword(table.tableName(), itemID, name);
+    host._index_keyword(table.tableName(), itemID, name);
+    host._invalidate_keyword_record(table.tableName(), itemID);
+}
 
-    // 汇集列字段名和组装查询语句
-    QList<DBAccess::KeywordField> cols;
-    QString exstr = "select id, name,";
-    auto cols_count = table_define.childCount();
-    for (auto index=0; index<cols_count; ++index){
-        exstr += QString("field_%1,").arg(index);
-        auto cell = table_define.childAt(index);
-        cols << cell;
-    }
+QString DBAccess::KeywordController::resetKeywordValueOf(const DBAccess::KeywordField &table, int itemID,
+                                                         int fieldIndex, const QVariant &value)
+{
+    auto sql = host.getStatement();
+    sql.prepare(QString("update "+table.tableName()+" set field_%1=:v where id=:id").arg(fieldIndex));
+    sql.bindValue(":id", itemID);
+    sql.bindValue(":v", value);
+    ExSqlQuery(sql);
+    host._invalidate_keyword_record(table.tableName(), itemID);
+
+    return displayTextOf(table.childAt(fieldIndex), value);
+}
+
+QString DBAccess::KeywordController::displayTextOf(const DBAccess::KeywordField &column, const QVariant &value) const
+{
+    switch (column.vType()) {
+        case KeywordField::ValueType::NUMBER:
+        case KeywordField::ValueType::STRING:
+            return value.toString();
+        case KeywordField::ValueType::ENUM:{
+                auto values = column.supplyValue().split(";");
+                auto item_index = value.toInt();
+                if(item_index <0 || item_index>=values.size())
+                    throw new WsException("存储值超界");
+                return values[item_index];
+            }
+        case KeywordField::ValueType::TABLEREF:{
+                if(value.isNull())
+                    return "悬空";
 
-    // 获取display-index
-    int display_index = -1;
-    QString name = queryWord;
-    if(name.lastIndexOf("%") != -1){
-        name = queryWord.mid(0, queryWord.lastIndexOf("%"));
-        display_index = queryWord.mid(queryWord.lastIndexOf("%")+1).toInt();
+                auto sql = host.getStatement();
+                sql.prepare("select name from "+column.supplyValue()+" where id=:id");
+                sql.bindValue(":id", value);
+                ExSqlQuery(sql);
+                if(!sql.next())
+                    throw new WsException("绑定空值");
+                return sql.value(0).toString();
+            }
     }
-    if(display_index < 0 || display_index >= cols.size()) display_index = -1;
+    return value.toString();
+}
 
+// 分隔文本读取：支持引号包裹的字段、字段内分隔符与换行
+static bool _read_separated_record(QTextStream &in, QChar separator, QStringList &fields)
+{
+    fields.clear();
+    if(in.atEnd())
+        return false;
+
+    QString field;
+    bool quoted = false;
+    while (!in.atEnd()) {
+        auto line = in.readLine();
+        for (int index=0; index<line.length(); ++index) {
+            auto ch = line.at(index);
+            if(quoted){
+                if(ch == '"' && index+1 < line.length() && line.at(index+1) == '"'){
+                    field += '"';
+                    index++;
+                }
+                else if(ch == '"')
+                    quoted = false;
+                else
+                    field += ch;
+            }
+            else if(ch == '"' && field.isEmpty())
+                quoted = true;
+            else if(ch == separator){
+                fields << field;
+                field.clear();
+            }
+            else
+                field += ch;
+        }
 
-    exstr = exstr.mid(0, exstr.length()-1) + " from " + table_define.tableName();
-    if(name != "*")
-        exstr += " where name like '%"+name+"%'";
+        if(!quoted)
+            break;
+        field += '\n';
+    }
 
-    sql.prepare(exstr);
-    ExSqlQuery(sql);
+    fields << field;
+    return true;
+}
 
-    while (sql.next()) {
-        QList<QStandardItem*> table_itemroot;
+static QString _separated_field(const QString &text, QChar separator)
+{
+    if(!text.contains(separator) && !text.contains('"') && !text.contains('\n'))
+        return text;
 
-        table_itemroot << new QStandardItem(sql.value(1).toString());
-        table_itemroot.last()->setData(sql.value(0), Qt::UserRole+1);
-        table_itemroot.last()->setData(table_define.tableName(), Qt::UserRole+2);
-        table_itemroot.last()->setData(table_define.name(), Qt::UserRole+3);
+    auto escaped = text;
+    return "\"" + escaped.replace("\"", "\"\"") + "\"";
+}
 
-        table_itemroot << new QStandardItem("-----------------");
-        table_itemroot.last()->setEditable(false);
+int DBAccess::KeywordController::importKeywords(const DBAccess::KeywordField &table, QTextStream &in, QChar separator,
+                                                 QStringList &rejected)
+{
+    const int batch_size = 1000;
+    if(!table.isTableDefine())
+        throw new WsException("传入节点不是表定义节点");
 
+    QStringList header;
+    if(!_read_separated_record(in, separator, header))
+        return 0;
 
-        int size = cols.size() + 2;
-        for (int index=2; index < size; ++index) {
-            auto colDef = cols.at(index-2);
+    // 表头映射：文件列 -> 字段序号，-1为名称列
+    const auto table_name = table.tableName();
+    QList<KeywordField> columns;
+    for (auto index=0; index<table.childCount(); ++index)
+        columns << table.childAt(index);
+
+    QHash<int, int> column_map;
+    for (auto col=0; col<header.size(); ++col) {
+        auto title = header.at(col).trimmed();
+        if(title == "名称" || title.compare("name", Qt::CaseInsensitive) == 0){
+            column_map[col] = -1;
+            continue;
+        }
+        for (auto index=0; index<columns.size(); ++index) {
+            if(columns.at(index).name() == title){
+                column_map[col] = index;
+                break;
+            }
+        }
+    }
+    if(!column_map.values().contains(-1))
+        throw new WsException("导入文件缺少“名称”列");
 
-            QList<QStandardItem*> field_row;
+    // ENUM候选与TABLEREF名称集合一次性载入
+    QHash<int, QHash<QString, int>> value_lookup;
+    auto sql = host.getStatement();
+    for (auto index=0; index<columns.size(); ++index) {
+        auto column = columns.at(index);
+        switch (column.vType()) {
+            case KeywordField::ValueType::ENUM:{
+                    auto enums = column.supplyValue().split(";");
+                    for (auto pos=0; pos<enums.size(); ++pos)
+                        value_lookup[index].insert(enums.at(pos), pos);
+                }break;
+            case KeywordField::ValueType::TABLEREF:{
+                    // 逆序载入，重名条目以id最小者覆盖
+                    sql.prepare("select id, name from " + column.supplyValue() + " order by id desc");
+                    ExSqlQuery(sql);
+                    while (sql.next())
+                        value_lookup[index].insert(sql.value(1).toString(), sql.value(0).toInt());
+                }break;
+            default:
+                break;
+        }
+    }
 
-            field_row << new QStandardItem(colDef.name());
-            field_row.last()->setEditable(false);
+    sql.prepare("select ifnull(max(id), 0) from " + table_name);
+    ExSqlQuery(sql);
+    sql.next();
+    auto id_floor = sql.value(0).toInt();
 
-            switch (colDef.vType()) {
-                case KeywordField::ValueType::NUMBER:
-                case KeywordField::ValueType::STRING:
-                    field_row << new QStandardItem(sql.value(index).toString());
-                    field_row.last()->setData(sql.value(index), Qt::UserRole+1);
+    QString insert_str = "insert into " + table_name + " (name";
+    QString values_str = ") values(?";
+    for (auto index=0; index<columns.size(); ++index) {
+        insert_str += QString(", field_%1").arg(index);
+        values_str += ", ?";
+    }
+    insert_str += values_str + ")";
+
+    auto transaction_owned = host.dbins.transaction();
+    int count = 0;
+    try {
+        QList<QVariantList> batch;
+        auto flush = [&]{
+            if(batch.first().isEmpty())
+                return;
+            sql.prepare(insert_str);
+            for (auto list : batch)
+                sql.addBindValue(list);
+            if(!sql.execBatch())
+                throw new WsException(sql.lastError().text());
+            for (auto &list : batch)
+                list.clear();
+        };
+        for (auto index=0; index<columns.size()+1; ++index)
+            batch << QVariantList();
+
+        QStringList record;
+        int record_index = 0;
+        while (_read_separated_record(in, separator, record)) {
+            record_index++;
+            if(record.size() == 1 && record.first().isEmpty())
+                continue;
+
+            QVector<QVariant> row(columns.size()+1);
+            QStringList unresolved;
+            for (auto it=column_map.constBegin(); it!=column_map.constEnd(); ++it) {
+                if(it.key() >= record.size())
+                    continue;
+
+                auto text = record.at(it.key());
+                if(it.value() < 0){
+                    row[0] = text;
+                    continue;
+                }
 
-                    if(display_index == index-2) table_itemroot[1]->setText(field_row[1]->text());
-                    break;
-                case KeywordField::ValueType::ENUM:{
-                        auto values = colDef.supplyValue().split(";");
-                        auto item_index = sql.value(index).toInt();
-                        if(item_index <0 || item_index>=values.size())
-                            throw new WsException("存储值超界");
-
-                        field_row << new QStandardItem(values[item_index]);
-                        field_row.last()->setData(sql.value(index));
-
-                        if(display_index == index-2) table_itemroot[1]->setText(field_row[1]->text());
-                    }break;
-                case KeywordField::ValueType::TABLEREF:{
-                        field_row << new QStandardItem("悬空");
-                        field_row.last()->setData(sql.value(index));
-
-                        if(!sql.value(index).isNull())
-                        {
-                            auto qex = host.getStatement();
-                            qex.prepare("select name from "+colDef.supplyValue()+" where id=:id");
-                            qex.bindValue(":id", sql.value(index));
-                            ExSqlQuery(qex);
-                            if(!qex.next())
-                                throw new WsException("绑定空值");
-                            field_row.last()->setText(qex.value(0).toString());
-                        }
-
-                        if(display_index == index-2) table_itemroot[1]->setText(field_row[1]->text());
-                    }break;
+                switch (columns.at(it.value()).vType()) {
+                    case KeywordField::ValueType::NUMBER:
+                        row[it.value()+1] = text.isEmpty()?QVariant():QVariant(text.toDouble());
+                        break;
+                    case KeywordField::ValueType::STRING:
+                        row[it.value()+1] = text;
+                        break;
+                    case KeywordField::ValueType::ENUM:
+                    case KeywordField::ValueType::TABLEREF:{
+                            auto &lookup = value_lookup[it.value()];
+                            if(lookup.contains(text))
+                                row[it.value()+1] = lookup.value(text);
+                            else if(!text.isEmpty())
+                                unresolved << QString("%1=“%2”").arg(columns.at(it.value()).name(), text);
+                        }break;
+                }
+            }
+            if(row[0].toString().isEmpty())
+                continue;
+            if(unresolved.size()){
+                rejected << QString("第%1条“%2”：%3无法识别，未导入").arg(record_index).arg(row[0].toString(), unresolved.join("，"));
+                continue;
             }
-            field_row.last()->setData(static_cast<int>(colDef.vType()), Qt::UserRole+2);
-            table_itemroot[0]->appendRow(field_row);
+
+            for (auto index=0; index<row.size(); ++index)
+                batch[index] << row[index];
+            count++;
+
+            if(batch.first().size() >= batch_size)
+                flush();
         }
+        flush();
+    } catch (WsException *e) {
+        if(transaction_owned)
+            host.dbins.rollback();
+        throw e;
+    }
+    if(transaction_owned && !host.dbins.commit())
+        throw new WsException(host.dbins.lastError().text());
 
-        disp_model->appendRow(table_itemroot);
+    // 登记新条目
+    sql.prepare("select id, name from " + table_name + " where id > :floor");
+    sql.bindValue(":floor", id_floor);
+    ExSqlQuery(sql);
+    QList<std::tuple<QString, int, QString>> keywords;
+    while (sql.next()) {
+        keywords << std::make_tuple(table_name, sql.value(0).toInt(), sql.value(1).toString());
+        host._index_keyword(table_name, sql.value(0).toInt(), sql.value(1).toString());
     }
-    host.connect_listen_connect(disp_model);
+    host.config_host.appendKeywords(keywords);
+    for (auto &item : keywords)
+        host._invalidate_keyword_record(table_name, std::get<1>(item));
+
+    return count;
 }
 
-void DBAccess::KeywordController::appendEmptyItemAt(const DBAccess::KeywordField &table, const QString &name)
+void DBAccess::KeywordController::exportKeywords(const DBAccess::KeywordField &table, QTextStream &out, QChar separator) const
 {
-    auto sql = host.getStatement();
-    sql.prepare("insert into "+table.tableName()+" (name) values (:nm)");
-    sql.bindValue(":nm", name);
-    ExSqlQuery(sql);
+    if(!table.isTableDefine())
+        throw new WsException("传入节点不是表定义节点");
 
-    sql.prepare("select id from "+table.tableName()+ " where name=:nm order by id desc");
-    sql.bindValue(":nm", name);
-    ExSqlQuery(sql);
+    QList<KeywordField> columns;
+    QStringList header;
+    header << "名称";
+    for (auto index=0; index<table.childCount(); ++index) {
+        columns << table.childAt(index);
+        header << _separated_field(columns.last().name(), separator);
+    }
+    out << header.join(separator) << "\n";
+
+    QString exstr = "select kw.name", joinstr, refstr;
+    QHash<int, QStringList> enum_values;
+    QHash<int, int> refname_columns;
+    for (auto index=0; index<columns.size(); ++index) {
+        exstr += QString(", kw.field_%1").arg(index);
+        switch (columns.at(index).vType()) {
+            case KeywordField::ValueType::ENUM:
+                enum_values[index] = columns.at(index).supplyValue().split(";");
+                break;
+            case KeywordField::ValueType::TABLEREF:
+                refname_columns[index] = 1 + columns.size() + refname_columns.size();
+                joinstr += QString(" left join %1 ref%2 on kw.field_%2 = ref%2.id").arg(columns.at(index).supplyValue()).arg(index);
+                refstr += QString(", ref%1.name").arg(index);
+                break;
+            default:
+                break;
+        }
+    }
 
-    if(!sql.next())
-        throw new WsException("插入新条目失败！");
+    auto sql = host.getStatement();
+    sql.setForwardOnly(true);
+    sql.prepare(exstr + refstr + " from " + table.tableName() + " kw" + joinstr + " order by kw.id");
+    ExSqlQuery(sql);
 
-    host.config_host.appendKeyword(table.tableName(), sql.value(0).toInt(), name);
+    while (sql.next()) {
+        QStringList record;
+        record << _separated_field(sql.value(0).toString(), separator);
+        for (auto index=0; index<columns.size(); ++index) {
+            auto value = sql.value(index+1);
+            QString text;
+            switch (columns.at(index).vType()) {
+                case KeywordField::ValueType::NUMBER:
+                case KeywordField::ValueType::STRING:
+                    text = value.toString();
+                    break;
+                case KeywordField::ValueType::ENUM:
+                    if(!value.isNull())
+                        text = enum_values[index].value(value.toInt());
+                    break;
+                case KeywordField::ValueType::TABLEREF:
+                    text = sql.value(refname_columns[index]).toString();
+                    break;
+            }
+            record << _separated_field(text, separator);
+        }
+        out << record.join(separator) << "\n";
+    }
 }
 
 void DBAccess::KeywordController::removeTargetItemAt(const DBAccess::KeywordField &table, const QModelIndex &index)
@@ -1459,6 +2547,8 @@ void DBAccess::KeywordController::removeTargetItemAt(const DBAccess::KeywordFiel
     ExSqlQuery(sql);
 
     host.config_host.removeKeyword(table.tableName(), id);
+    host._unindex_keyword(table.tableName(), id);
+    host._invalidate_keyword_record(table.tableName(), id);
 }
 
 QList<QPair<int, QString>> DBAccess::KeywordController::avaliableEnumsForIndex(const QModelIndex &index) const
@@ -1509,57 +2599,184 @@ QList<QPair<int, QString> > DBAccess::KeywordController::avaliableItemsForIndex(
     return retlist;
 }
 
+QList<QPair<int, QString>> DBAccess::KeywordController::searchItemsForIndex(const QModelIndex &index, const QString &fragment,
+                                                                           int limit) const
+{
+    auto type = static_cast<KeywordField::ValueType>(index.data(Qt::UserRole+2).toInt());
+    if(type != KeywordField::ValueType::TABLEREF)
+        throw new WsException("目标数据类型不为TABLEREF");
+
+    if(!index.column())
+        return QList<QPair<int, QString>>();
+
+    auto kw_type = index.parent().data(Qt::UserRole+3).toString();
+    auto column_def = findTableViaTypeName(kw_type).childAt(index.row());
+
+    return keywordsContains(findTableViaTableName(column_def.supplyValue()), fragment, limit);
+}
+
+QList<QPair<int, QString>> DBAccess::KeywordController::keywordsContains(const DBAccess::KeywordField &table,
+                                                                        const QString &fragment, int limit) const
+{
+    auto table_name = table.tableName();
+    const auto names = host.keywords_name_index.value(table_name);
+
+    QList<int> ids;
+    if(fragment.isEmpty()){
+        ids = names.keys();
+    }
+    else {
+        // 取最小候选集合，逐一校验其余n元与完整片段
+        const auto grams_index = host.keywords_ngram_index.value(table_name);
+        QList<QSet<int>> candidates;
+        for (auto gram : _keyword_grams(fragment, true)) {
+            if(!grams_index.contains(gram))
+                return QList<QPair<int, QString>>();
+            candidates << grams_index.value(gram);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const QSet<int> &a, const QSet<int> &b){
+            return a.size() < b.size();
+        });
+
+        for (auto id : candidates.first()) {
+            if(names.value(id).contains(fragment, Qt::CaseInsensitive))
+                ids << id;
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+
+    QList<QPair<int, QString>> result;
+    for (auto id : ids) {
+        if(limit >= 0 && result.size() >= limit)
+            break;
+        result << qMakePair(id, names.value(id));
+    }
+    return result;
+}
+
+// 引用链展开深度上限
+static const int keywords_expand_depth_limit = 8;
+// 条目缓存容量上限
+static const int keywords_records_cache_limit = 4096;
+
 void DBAccess::KeywordController::queryKeywordsViaMixtureList(const QList<QPair<QString, int>> &mixttureList,
                                                               QStandardItemModel *disp_model) const
 {
     disp_model->clear();
     disp_model->setHorizontalHeaderLabels(QStringList() << "类别"<<"数据");
 
-    for (auto pair : mixttureList) {
-        queryKeywordsRescursive(pair, disp_model);
-    }
+    fetchKeywordsRecords(mixttureList);
+    for (auto pair : mixttureList)
+        disp_model->appendRow(quickLookRowOf(pair));
 }
 
-void DBAccess::KeywordController::queryKeywordsRescursive(const QPair<QString, int> pair, QStandardItemModel *disp_model,
-                                                          QPair<QStandardItem *,QStandardItem *> pTitleRow) const
+QList<QStandardItem*> DBAccess::KeywordController::quickLookRowOf(const QPair<QString, int> &keyAcc,
+                                                                  QSet<QPair<QString, int>> *involved) const
 {
-    const auto table_define = findTableViaTableName(pair.first);
-    if(!table_define.isValid()) throw new WsException(QString("传入的表名无效:pair<%1,%2>").arg(pair.first).arg(pair.second));
+    fetchKeywordsRecords(QList<RecordKey>() << keyAcc);
+    if(!host.keywords_records_cache.contains(keyAcc))
+        throw new WsException(QString("输入的查询条件错误：<%1,%2>").arg(keyAcc.first).arg(keyAcc.second));
 
-    auto sql = host.getStatement();
-    // 汇集列字段名和组装查询语句
-    QList<DBAccess::KeywordField> cols;
-    QString exstr = "select id, name,";
-    auto cols_count = table_define.childCount();
-    for (auto index=0; index<cols_count; ++index){
-        exstr += QString("field_%1,").arg(index);
-        cols << table_define.childAt(index);
-    }
+    QList<QStandardItem*> title_row;
+    title_row << new QStandardItem(findTableViaTableName(keyAcc.first).name());
+    title_row.last()->setEditable(false);
+    title_row.last()->setData(keyAcc.first, Qt::UserRole+1);
+    title_row.last()->setData(keyAcc.second, Qt::UserRole+2);
+    title_row << new QStandardItem("悬空占位");
+    title_row.last()->setEditable(false);
 
-    exstr = exstr.mid(0, exstr.length()-1) + " from " + pair.first + " where id=:id";
-    sql.prepare(exstr);
-    sql.bindValue(":id", pair.second);
-    ExSqlQuery(sql);
+    QSet<RecordKey> path;
+    fillKeywordsRecursive(keyAcc, path, 0, qMakePair(title_row[0], title_row[1]), involved);
+    return title_row;
+}
 
-    if(!sql.next()) throw new WsException(QString("输入的查询条件错误：<%1,%2>").arg(pair.first).arg(pair.second));
+void DBAccess::KeywordController::fetchKeywordsRecords(const QList<RecordKey> &roots) const
+{
+    auto &records = host.keywords_records_cache;
+    // 超出上限时整体清空，再按本次查询载入，保证随后展开所需条目齐全
+    if(records.size() > keywords_records_cache_limit)
+        records.clear();
+
+    QSet<RecordKey> visited;
+    QHash<QString, QSet<int>> frontier;
+    for (auto key : roots)
+        frontier[key.first] << key.second;
+
+    auto sql = host.getStatement();
+    for (int depth=0; depth<=keywords_expand_depth_limit && frontier.size(); ++depth) {
+        QHash<QString, QSet<int>> next_frontier;
+
+        for (auto it=frontier.constBegin(); it!=frontier.constEnd(); ++it) {
+            const auto table_define = findTableViaTableName(it.key());
+            if(!table_define.isValid())
+                throw new WsException(QString("传入的表名无效:%1").arg(it.key()));
+
+            QList<KeywordField> cols;
+            auto cols_count = table_define.childCount();
+            for (auto index=0; index<cols_count; ++index)
+                cols << table_define.childAt(index);
+
+            QStringList ids;
+            for (auto id : it.value()) {
+                if(!records.contains(qMakePair(it.key(), id)))
+                    ids << QString::number(id);
+            }
+            if(ids.size()){
+                QString exstr = "select id, name";
+                for (auto index=0; index<cols_count; ++index)
+                    exstr += QString(", field_%1").arg(index);
+                sql.prepare(exstr + " from " + it.key() + " where id in (" + ids.join(",") + ")");
+                ExSqlQuery(sql);
 
-    // 添加根级别新条目
-    if(!pTitleRow.first){
-        QList<QStandardItem*> title_row;
+                while (sql.next()) {
+                    QList<QVariant> values;
+                    for (auto index=0; index<cols_count+2; ++index)
+                        values << sql.value(index);
+                    records[qMakePair(it.key(), sql.value(0).toInt())] = values;
+                }
+            }
 
-        title_row << new QStandardItem(table_define.name());
-        title_row.last()->setEditable(false);
-        title_row << new QStandardItem("悬空占位");
-        title_row.last()->setEditable(false);
+            // 已缓存条目同样沿引用继续，保证引用链完整载入
+            for (auto id : it.value()) {
+                auto key = qMakePair(it.key(), id);
+                if(visited.contains(key) || !records.contains(key))
+                    continue;
+                visited << key;
+
+                const auto &values = records[key];
+                for (auto index=0; index<cols_count; ++index) {
+                    auto value = values.at(index+2);
+                    if(cols.at(index).vType() != KeywordField::ValueType::TABLEREF || value.isNull())
+                        continue;
+
+                    auto ref_key = qMakePair(cols.at(index).supplyValue(), value.toInt());
+                    if(!visited.contains(ref_key))
+                        next_frontier[ref_key.first] << ref_key.second;
+                }
+            }
+        }
 
-        disp_model->appendRow(title_row);
-        pTitleRow = qMakePair(title_row[0], title_row[1]);
+        frontier = next_frontier;
     }
-    pTitleRow.second->setText(sql.value(1).toString());
+}
 
-    int size = cols.size() + 2;
-    for (int index=2; index < size; ++index) {
-        auto colDef = cols.at(index-2);
+void DBAccess::KeywordController::fillKeywordsRecursive(const RecordKey &key, QSet<RecordKey> &path, int depth,
+                                                        QPair<QStandardItem*, QStandardItem*> titleRow, QSet<RecordKey> *involved) const
+{
+    const auto &records = host.keywords_records_cache;
+    if(involved)
+        involved->insert(key);
+    const auto values = records.value(key);
+    titleRow.second->setText(values.at(1).toString());
+    if(depth >= keywords_expand_depth_limit)
+        return;
+
+    path << key;
+    const auto table_define = findTableViaTableName(key.first);
+    auto cols_count = table_define.childCount();
+    for (int index=0; index < cols_count; ++index) {
+        auto colDef = table_define.childAt(index);
+        auto value = values.at(index+2);
 
         // 一个子条目
         QList<QStandardItem*> field_row;
@@ -1568,29 +2785,36 @@ void DBAccess::KeywordController::queryKeywordsRescursive(const QPair<QString, i
         switch (colDef.vType()) {
             case KeywordField::ValueType::NUMBER:
             case KeywordField::ValueType::STRING:
-                field_row << new QStandardItem(sql.value(index).toString());
+                field_row << new QStandardItem(value.toString());
                 break;
             case KeywordField::ValueType::ENUM:{
-                    auto values = colDef.supplyValue().split(";");
-                    auto item_index = sql.value(index).toInt();
-                    if(item_index <0 || item_index>=values.size())
+                    auto enums = colDef.supplyValue().split(";");
+                    auto item_index = value.toInt();
+                    if(item_index <0 || item_index>=enums.size())
                         throw new WsException("存储值超界");
 
-                    field_row << new QStandardItem(values[item_index]);
+                    field_row << new QStandardItem(enums[item_index]);
                 }break;
             case KeywordField::ValueType::TABLEREF:{
                     field_row << new QStandardItem("悬空");
+                    if(value.isNull())
+                        break;
 
-                    if(!sql.value(index).isNull())
-                        queryKeywordsRescursive(
-                                    qMakePair(colDef.supplyValue(), sql.value(index).toInt()),
-                                    nullptr, qMakePair(field_row[0], field_row[1]));
+                    auto ref_key = qMakePair(colDef.supplyValue(), value.toInt());
+                    // 悬空引用同样登记，被引用条目新建后可据此刷新
+                    if(involved)
+                        involved->insert(ref_key);
+                    if(path.contains(ref_key))
+                        field_row[1]->setText("(循环引用)");
+                    else if(records.contains(ref_key))
+                        fillKeywordsRecursive(ref_key, path, depth+1, qMakePair(field_row[0], field_row[1]), involved);
                 }break;
         }
 
         for(auto item : field_row) item->setEditable(false);
-        pTitleRow.first->appendRow(field_row);
+        titleRow.first->appendRow(field_row);
     }
+    path.remove(key);
 }
 
 
@@ -1,10 +1,14 @@
 #ifndef DATAACCESS_H
 #define DATAACCESS_H
 
+#include <QDateTime>
 #include <QSqlDatabase>
 #include <QVariant>
+#include <QVector>
 #include <QRandomGenerator>
+#include <QSet>
 #include <QStandardItemModel>
+#include <QTextStream>
 
 #include "confighost.h"
 
@@ -82,6 +86,52 @@ namespace NovelBase {
                                             int index, const QString &title, const QString &description);
 
             StoryTreeNode getNodeViaID(int id) const;
+            /**
+             * @brief 由已知id与类型还原节点句柄，不访问数据库
+             */
+            StoryTreeNode nodeOf(int id, StoryTreeNode::Type type) const;
+            /**
+             * @brief 截至指定卷宗（含）的所有支线，按卷宗与序号排列：(标题, id)
+             */
+            QList<QPair<QString, int>> desplinesUntil(const StoryTreeNode &volume) const;
+            /**
+             * @brief 全书章节id，按卷宗与章节序号排列
+             */
+            QList<int> chapterSequence() const;
+            /**
+             * @brief 导航骨架节点，parent为父节点id
+             */
+            struct SkeletonNode{
+                int id;
+                StoryTreeNode::Type type;
+                int parent;
+                QString title;
+            };
+            /**
+             * @brief 单次查询取得卷宗、章节、剧情、分解点骨架，父节点总是先于子节点，同级按序号排列
+             */
+            QVector<SkeletonNode> navigateSkeleton() const;
+            /**
+             * @brief 指定节点子树（含自身）全部描述：id : 描述
+             */
+            QHash<int, QString> descriptionsUnder(const StoryTreeNode &pnode) const;
+
+            /**
+             * @brief 删除影响的驻点记录，id为-1代表未吸附，removed标志代表该节点位于删除子树内
+             */
+            struct PointImpact{
+                int point_id;
+                int despline_id, chapter_id, storyblock_id;
+                QString despline_title, chapter_title, storyblock_title;
+                bool despline_removed, chapter_removed, storyblock_removed;
+            };
+            /**
+             * @brief 以递归查询汇总删除指定节点子树的影响
+             * @param desplines 随之删除的支线：(id, 标题)
+             * @param points 受影响驻点，按支线与序号排列
+             */
+            void removeImpactOf(const StoryTreeNode &target, QList<QPair<int, QString>> &desplines,
+                                QList<PointImpact> &points) const;
 
         private:
             DBAccess &host;
@@ -89,8 +139,49 @@ namespace NovelBase {
 
 
         // contents_collect
+        enum class ChapterLayout{
+            WHOLE = 0,          // 整章单行存储
+            PARAGRAPHS = 1      // 逐段存储于paragraphs_collect
+        };
         QString chapterText(const StoryTreeNode &chapter) const;
         void resetChapterText(const StoryTreeNode &chapter, const QString &text);
+        /**
+         * @brief 超过paragraph_layout_threshold的章节转为逐段存储，保存时仅写入变化段落；
+         * 缩减至阈值一半以下后转回整章存储
+         */
+        ChapterLayout chapterLayoutOf(const StoryTreeNode &chapter) const;
+        /**
+         * @brief 分段读取章节内容，count=-1代表读取至末尾
+         */
+        QStringList chapterParagraphs(const StoryTreeNode &chapter, int offset=0, int count=-1) const;
+        /**
+         * @brief 记录章节有效字数，供未载入章节显示
+         */
+        void resetChapterWordsCount(const StoryTreeNode &chapter, int words);
+        /**
+         * @brief 全书已记录的章节字数：chapter-id : words
+         */
+        QHash<int, int> chaptersWordsCount() const;
+
+        // revisions_collect
+        /**
+         * @brief 为章节追加修订快照，内容与最近修订一致时不写入
+         */
+        void appendChapterRevision(const StoryTreeNode &chapter, const QString &text);
+        /**
+         * @brief 章节修订列表，按时间升序，无效时间代表不限制：修订id : 时间戳
+         */
+        QList<QPair<int, QDateTime>> chapterRevisions(const StoryTreeNode &chapter,
+                                                      const QDateTime &from=QDateTime(), const QDateTime &to=QDateTime()) const;
+        /**
+         * @brief 指定时刻章节所处修订，无修订返回-1
+         */
+        int chapterRevisionAt(const StoryTreeNode &chapter, const QDateTime &stamp) const;
+        QString revisionText(int revisionID) const;
+        /**
+         * @brief 回收删除章节后失去引用的修订数据块，删除节点时仅作标记，无标记直接返回
+         */
+        void collectRevisionChunks();
 
 
         // points_collect operate
@@ -145,6 +236,14 @@ namespace NovelBase {
 
             bool moveUpOf(const BranchAttachPoint &point);
             bool moveDownOf(const BranchAttachPoint &point);
+
+            /**
+             * @brief 单次查询支线下按吸附目标筛选的驻点，按序号排列：(标题, id)
+             * @param attachType 吸附类别，CHAPTER或STORYBLOCK
+             * @param attached 吸附目标，无效节点代表筛选未吸附驻点
+             */
+            QList<QPair<QString, int>> pointsSummaryOf(const StoryTreeNode &despline, StoryTreeNode::Type attachType,
+                                                       const StoryTreeNode &attached) const;
         private:
             DBAccess &host;
         };
@@ -231,36 +330,131 @@ namespace NovelBase {
 
 
             // items 操作
-            void queryKeywordsLike(QStandardItemModel *disp_model, const QString &name, const DBAccess::KeywordField &table) const;
-
             void appendEmptyItemAt(const KeywordField &table, const QString &name);
+            /**
+             * @brief 修改条目名称并同步关键字登记
+             */
+            void resetKeywordNameOf(const KeywordField &table, int itemID, const QString &name);
+            /**
+             * @brief 修改条目指定字段存储值
+             * @return 该值的显示文本
+             */
+            QString resetKeywordValueOf(const KeywordField &table, int itemID, int fieldIndex, const QVariant &value);
+            QString displayTextOf(const KeywordField &column, const QVariant &value) const;
             void removeTargetItemAt(const KeywordField &table, const QModelIndex &index);
 
+            /**
+             * @brief 从分隔文本流式批量导入条目，首行为表头：“名称”列对应条目名称，其余列按字段名称对应
+             * ENUM按候选文本匹配；TABLEREF按引用表条目名称匹配，重名时取id最小者
+             * @param separator 分隔符，CSV为“,”，TSV为“\t”
+             * @param rejected 含无法识别的ENUM/TABLEREF取值而未导入的记录说明
+             * @return 导入条目数量
+             */
+            int importKeywords(const KeywordField &table, QTextStream &in, QChar separator, QStringList &rejected);
+            /**
+             * @brief 以分隔文本导出全部条目，ENUM与TABLEREF输出显示文本
+             */
+            void exportKeywords(const KeywordField &table, QTextStream &out, QChar separator) const;
+
             QList<QPair<int, QString>> avaliableEnumsForIndex(const QModelIndex &index) const;
             QList<QPair<int, QString>> avaliableItemsForIndex(const QModelIndex &index) const;
+            /**
+             * @brief 按名称片段检索指定字段可引用的条目
+             * @param limit 最大返回数，-1不限制
+             */
+            QList<QPair<int, QString>> searchItemsForIndex(const QModelIndex &index, const QString &fragment, int limit=-1) const;
+            /**
+             * @brief 通过名称n元索引查找名称包含片段的条目，按id升序：id : name
+             * @param limit 最大返回数，-1不限制
+             */
+            QList<QPair<int, QString>> keywordsContains(const KeywordField &table, const QString &fragment, int limit=-1) const;
 
             // pick-mixture-itemslist
             void queryKeywordsViaMixtureList(const QList<QPair<QString, int>> &mixttureList, QStandardItemModel *disp_model) const;
+            /**
+             * @brief 生成单个条目的展开行，根条目携带Qt::UserRole+1(表名)与Qt::UserRole+2(id)
+             * @param involved 非空时填入该行展开涉及的全部条目
+             */
+            QList<QStandardItem*> quickLookRowOf(const QPair<QString, int> &keyAcc,
+                                                 QSet<QPair<QString, int>> *involved = nullptr) const;
 
         private:
             DBAccess &host;
 
-            void queryKeywordsRescursive(const QPair<QString, int> keyAcc, QStandardItemModel *disp_model,
-                                         QPair<QStandardItem*, QStandardItem*> pTitleRow = qMakePair(nullptr, nullptr)) const;
+            //                        table-name : id
+            using RecordKey = QPair<QString, int>;
+            /**
+             * @brief 按层批量载入条目及其引用链至条目缓存，每层每表一次查询
+             */
+            void fetchKeywordsRecords(const QList<RecordKey> &roots) const;
+            void fillKeywordsRecursive(const RecordKey &key, QSet<RecordKey> &path, int depth,
+                                       QPair<QStandardItem*, QStandardItem*> titleRow, QSet<RecordKey> *involved) const;
         };
 
         QSqlQuery getStatement() const;
+        /**
+         * @brief 当前数据库文件路径
+         */
+        QString filePath() const;
+
+    signals:
+        /**
+         * @brief 关键字条目或结构被修改，已缓存的条目内容失效
+         */
+        void keywordsRecordsChanged();
+        /**
+         * @brief 单个条目名称或取值被修改、条目新增或删除，仅该条目缓存失效
+         */
+        void keywordRecordChanged(const QString &tableName, int id);
+
     private:
         ConfigHost &config_host;
 
         QSqlDatabase dbins;
         QRandomGenerator intGen;
-
-        void disconnect_listen_connect(QStandardItemModel *model);
-        void connect_listen_connect(QStandardItemModel *model);
-        void listen_keywordsmodel_itemchanged(QStandardItem *item);
+        const int paragraph_layout_threshold;     // 逐段存储的章节字符数阈值
+
+        // tables_define 内存目录，惰性载入，结构变更时失效
+        struct SchemaEntry{
+            int type;
+            int parent;
+            int index;
+            QString name;
+            int vtype;
+            QString supply;
+        };
+        mutable bool schema_loaded;
+        mutable int schema_root_id;
+        mutable QHash<int, SchemaEntry> schema_catalog;
+        //                parent : children-id(按nindex排序)
+        mutable QHash<int, QList<int>> schema_children;
+
+        void _load_schema_catalog() const;
+        const SchemaEntry &_schema_entry(int fieldID) const;
+        void _invalidate_schema_catalog();
+
+        // 关键字条目缓存：(table-name, id) : [id, name, field_0, ...]，超出上限时于下次载入前清空
+        mutable QHash<QPair<QString, int>, QList<QVariant>> keywords_records_cache;
+        void _invalidate_keywords_records();
+        void _invalidate_keyword_record(const QString &tableName, int id);
+
+        // 关键字名称n元索引(单字、双字)：table-name : gram : ids
+        QHash<QString, QHash<QString, QSet<int>>> keywords_ngram_index;
+        //                         table-name : id : name
+        QHash<QString, QHash<int, QString>> keywords_name_index;
+        void _index_keyword(const QString &tableName, int id, const QString &name);
+        void _unindex_keyword(const QString &tableName, int id);
 
         void init_tables(QSqlDatabase &db);
+        void _ensure_extended_tables();
+        void _reset_chapter_paragraphs(const StoryTreeNode &chapter, const QStringList &paragraphs);
+        QList<QByteArray> _revision_manifest(int revisionID, int *depthOut=nullptr) const;
+        // 曾删除章节修订，存在待回收的数据块
+        bool revision_chunks_dirty;
+        /**
+         * @brief 清除不再被任何修订清单引用的数据块
+         */
+        void _collect_revision_chunks();
 
         void _push_all_keywords_to_confighost();
     };
@@ -4,8 +4,11 @@
 
 #include <QtDebug>
 #include <QScrollBar>
+#include <QAbstractItemView>
+#include <QKeyEvent>
 #include <QMenu>
 #include <QInputDialog>
+#include <QLineEdit>
 #include <QMessageBox>
 #include <QGridLayout>
 #include <QMenuBar>
@@ -37,6 +40,7 @@ using VfrmType = ViewFrame::FrameType;
 #define KEYWORDS_MANAGER_VIEW "关键字管理"
 #define KEYWORDS_QUICKLOOK_VIEW "关键字提示"
 #define SEARCH_RESULT_LABLE_VIEW "搜索操作"
+#define DESPLINES_COVERAGE_VIEW "全书支线统计"
 
 const QString treeview_style = "QTreeView { alternate-background-color: #f7f7f7; show-decoration-selected: 1; }"
                                "QTreeView::item {  border: 1px solid #d9d9d9; border-right-color: transparent; "
@@ -84,12 +88,14 @@ MainFrame::MainFrame(NovelHost *core, ConfigHost &host, QWidget *parent)
     setWindowTitle(novel_core->novelTitle());
     connect(novel_core, &NovelHost::taskAppended,   report,   &TaskReport::increaseTaskCount);
     connect(novel_core, &NovelHost::taskFinished,   report,   &TaskReport::reduceTaskCount);
+    connect(novel_core, &NovelHost::taskProgress,   report,   &TaskReport::updateTaskProgress);
 
     {
         auto file = menuBar()->addMenu("文件");
         file->addAction("增加卷宗",     this,   &MainFrame::append_volume);
         file->addSeparator();
         file->addAction("保存状态",     this, &MainFrame::saveOp);
+        file->addAction("在线备份",     this, &MainFrame::backupOp);
         file->addSeparator();
         file->addAction("重命名小说",    this,   &MainFrame::rename_novel_title);
 
@@ -178,6 +184,7 @@ void MainFrame::load_all_predefine_views(){
     views_group.append(std::make_tuple(KEYWORDS_MANAGER_VIEW, group_keywords_manager_view(novel_core), nullptr));
     views_group.append(std::make_tuple(KEYWORDS_QUICKLOOK_VIEW, group_keywords_quicklook_view(novel_core->quicklookItemsModel()), nullptr));
     views_group.append(std::make_tuple(SEARCH_RESULT_LABLE_VIEW, group_search_result_summary_panel(), nullptr));
+    views_group.append(std::make_tuple(DESPLINES_COVERAGE_VIEW, group_desplines_coverage_panel(), nullptr));
 
     for(auto tuple : views_group) std::get<1>(tuple)->setVisible(false);
 }
@@ -282,6 +289,9 @@ QWidget *MainFrame::group_keywords_manager_view(NovelHost *novel_core)
             auto addItem = new QPushButton("添加新条目", panel);
             addItem->setEnabled(false);
             auto removeItem = new QPushButton("移除指定条目", panel);
+            auto importItems = new QPushButton("批量导入条目", panel);
+            auto exportItems = new QPushButton("导出全部条目", panel);
+            auto listMentions = new QPushButton("查看全部提及", panel);
 
 
             layout->addWidget(typeSelect);
@@ -289,6 +299,9 @@ QWidget *MainFrame::group_keywords_manager_view(NovelHost *novel_core)
             layout->addWidget(view, 1, 0, 4, 4);
             layout->addWidget(addItem, 5, 0, 1, 2);
             layout->addWidget(removeItem, 5, 2, 1, 2);
+            layout->addWidget(importItems, 6, 0, 1, 2);
+            layout->addWidget(exportItems, 6, 2, 1, 2);
+            layout->addWidget(listMentions, 7, 0, 1, 4);
 
 
             connect(view, &QTreeView::expanded,   [view]{
@@ -330,6 +343,55 @@ QWidget *MainFrame::group_keywords_manager_view(NovelHost *novel_core)
                 enter->setText("清空");
                 enter->setText(name);
             });
+            connect(importItems,    &QPushButton::clicked,  [this, novel_core, enter, typeSelect]{
+                auto mindex = typeSelect->currentData().toModelIndex();
+                if(mindex == QModelIndex()) return ;
+
+                auto path = QFileDialog::getOpenFileName(this, "批量导入条目", QDir::homePath(), "分隔文本(*.csv *.tsv)");
+                if(path == "") return ;
+
+                try {
+                    QStringList rejected;
+                    auto count = novel_core->importKeywordsViaTheList(mindex, path, rejected);
+                    if(rejected.isEmpty())
+                        QMessageBox::information(this, "批量导入条目", QString("成功导入%1条").arg(count));
+                    else
+                        QMessageBox::warning(this, "批量导入条目", QString("成功导入%1条，%2条未导入：\n").arg(count).arg(rejected.size())
+                                             + rejected.mid(0, 20).join("\n") + (rejected.size()>20?"\n……":""));
+                } catch (WsException *e) {
+                    QMessageBox::critical(this, "批量导入条目", e->reason());
+                }
+
+                auto temp = enter->text();
+                enter->setText("清空");
+                enter->setText(temp);
+            });
+            connect(exportItems,    &QPushButton::clicked,  [this, novel_core, typeSelect]{
+                auto mindex = typeSelect->currentData().toModelIndex();
+                if(mindex == QModelIndex()) return ;
+
+                auto path = QFileDialog::getSaveFileName(this, "导出全部条目", QDir::homePath(), "CSV(*.csv);;TSV(*.tsv)");
+                if(path == "") return ;
+
+                try {
+                    novel_core->exportKeywordsViaTheList(mindex, path);
+                } catch (WsException *e) {
+                    QMessageBox::critical(this, "导出全部条目", e->reason());
+                }
+            });
+            connect(listMentions,   &QPushButton::clicked,  [this, view, novel_core]{
+                auto index = view->currentIndex();
+                if(!index.isValid()) return ;
+                if(index.parent().isValid())
+                    index = index.parent();
+                index = index.sibling(index.row(), 0);
+
+                auto table = index.data(Qt::UserRole+2).toString();
+                auto id = index.data(Qt::UserRole+1).toInt();
+                WsExcept(novel_core->listKeywordMentions(table, id));
+                QMessageBox::information(this, "查看全部提及",
+                                         QString("共%1处提及，已列入“%2”").arg(novel_core->findResultTable()->rowCount()).arg(SEARCH_RESULT_LABLE_VIEW));
+            });
             connect(removeItem, &QPushButton::clicked,  [view, novel_core, enter, typeSelect]{
                 auto mindex = typeSelect->currentData().toModelIndex();
                 if(mindex == QModelIndex()) return ;
@@ -539,6 +601,31 @@ QWidget *MainFrame::group_keywords_quicklook_view(QAbstractItemModel *model)
     return view;
 }
 
+QWidget *MainFrame::group_desplines_coverage_panel()
+{
+    auto coverage_pane = new QWidget(this);
+
+    auto view = new QTreeView(coverage_pane);
+    view->setAlternatingRowColors(true);
+    view->setStyleSheet(treeview_style);
+    auto refresh = new QPushButton("刷新统计", coverage_pane);
+
+    auto layout_0 = new QGridLayout(coverage_pane);
+    layout_0->setMargin(0);
+    layout_0->setSpacing(2);
+    layout_0->addWidget(view, 0, 0, 5, 3);
+    layout_0->addWidget(refresh, 5, 0, 1, 1);
+
+    auto novel_core = this->novel_core;
+    connect(refresh,    &QPushButton::clicked,  [view, novel_core]{
+        WsExcept(view->setModel(novel_core->desplinesCoverageChart()));
+        view->expandAll();
+        view->resizeColumnToContents(0);
+    });
+
+    return coverage_pane;
+}
+
 QWidget *MainFrame::group_search_result_summary_panel()
 {
     auto search_pane = new QWidget(this);
@@ -1549,7 +1636,7 @@ void MainFrame::append_despline_from_chapters()
     else
         novel_core->appendDesplineUnder(index.parent(), name, desp0);
 
-    refresh_desplineview();
+    resize_foreshadows_tableitem_width();
 }
 
 void MainFrame::pointattach_from_chapter(QAction *item)
@@ -1560,14 +1647,14 @@ void MainFrame::pointattach_from_chapter(QAction *item)
 
     novel_core->chapterAttachSet(index, item->data().toInt());
 
-    refresh_desplineview();
+    resize_foreshadows_tableitem_width();
 }
 
 void MainFrame::pointclear_from_chapter(QAction *item)
 {
     novel_core->chapterAttachClear(item->data().toInt());
 
-    refresh_desplineview();
+    resize_foreshadows_tableitem_width();
 }
 
 void MainFrame::remove_selected_chapters()
@@ -1628,23 +1715,16 @@ void MainFrame::outlines_navigate_jump(const QModelIndex &_index)
 
     try {
         novel_core->setCurrentOutlineNode(index);
-        auto blk = novel_core->volumeOutlinesPresent()->firstBlock();
-        while (blk.isValid()) {
-            if(blk.userData()){
-                auto ndata = static_cast<NovelBase::WsBlockData*>(blk.userData());
-                if(ndata->navigateIndex() == index){
-                    QTextCursor cursor(blk);
-                    static_cast<QTextEdit*>(get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW))->setTextCursor(cursor);
-
-                    auto at_value = static_cast<QTextEdit*>(get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW))
-                                    ->verticalScrollBar()->value();
-                    static_cast<QTextEdit*>(get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW))
-                            ->verticalScrollBar()->setValue(at_value + static_cast<QTextEdit*>(get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW))
-                                                            ->cursorRect().y());
-                    break;
-                }
-            }
-            blk = blk.next();
+        auto blk = novel_core->volumeOutlinesTitleBlock(index);
+        if(blk.isValid()){
+            QTextCursor cursor(blk);
+            static_cast<QTextEdit*>(get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW))->setTextCursor(cursor);
+
+            auto at_value = static_cast<QTextEdit*>(get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW))
+                            ->verticalScrollBar()->value();
+            static_cast<QTextEdit*>(get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW))
+                    ->verticalScrollBar()->setValue(at_value + static_cast<QTextEdit*>(get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW))
+                                                    ->cursorRect().y());
         }
         resize_foreshadows_tableitem_width();
     } catch (WsException *e) {
@@ -1837,7 +1917,7 @@ void MainFrame::append_despline_from_outlines()
 
     novel_core->appendDesplineUnder(index, title, desp);
 
-    refresh_desplineview();
+    resize_foreshadows_tableitem_width();
 }
 
 void MainFrame::pointattach_from_storyblock(QAction *item)
@@ -1848,14 +1928,14 @@ void MainFrame::pointattach_from_storyblock(QAction *item)
 
     novel_core->storyblockAttachSet(index, item->data().toInt());
 
-    refresh_desplineview();
+    resize_foreshadows_tableitem_width();
 }
 
 void MainFrame::pointclear_from_storyblock(QAction *item)
 {
     novel_core->storyblockAttachClear(item->data().toInt());
 
-    refresh_desplineview();
+    resize_foreshadows_tableitem_width();
 }
 
 void MainFrame::remove_selected_outlines()
@@ -1895,6 +1975,19 @@ void MainFrame::saveOp()
     }
 }
 
+void MainFrame::backupOp()
+{
+    auto target_dir = QFileDialog::getExistingDirectory(this, "选择备份目录", QDir::homePath());
+    if(target_dir == "")
+        return;
+
+    try {
+        novel_core->backupTo(target_dir);
+    } catch (WsException *e) {
+        QMessageBox::critical(this, "在线备份", e->reason(), QMessageBox::Ok);
+    }
+}
+
 void MainFrame::autosave_timespan_reset()
 {
     bool ok;
@@ -1904,10 +1997,19 @@ void MainFrame::autosave_timespan_reset()
     timer_autosave->start(timespan*1000*60);
 }
 
-void MainFrame::documentClosed(QTextDocument *)
+void MainFrame::documentClosed(QTextDocument *doc)
 {
     setWindowTitle(novel_core->novelTitle());
-    //chapter_textedit_present->setDocument(empty_document);
+
+    auto editor = static_cast<QTextEdit*>(this->get_view_according_name(ARTICLES_EDITOR_VIEW));
+    if(editor->document() == doc)
+        editor->setDocument(new QTextDocument(editor));
+
+    auto volume_outlines_view = static_cast<QTextEdit*>(this->get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW));
+    if(volume_outlines_view->document() == doc){
+        volume_outlines_view->setDocument(novel_core->volumeOutlinesPresent());
+        volume_outlines_view->setEnabled(false);
+    }
 }
 
 void MainFrame::documentPresent(QTextDocument *doc, const QString &title)
@@ -1929,7 +2031,10 @@ void MainFrame::currentChaptersAboutPresent()
 
 void MainFrame::currentVolumeOutlinesPresent()
 {
-    get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW)->setEnabled(true);
+    auto volume_outlines_view = static_cast<QTextEdit*>(get_view_according_name(VOLUME_OUTLINES_EDIT_VIEW));
+    if(volume_outlines_view->document() != novel_core->volumeOutlinesPresent())
+        volume_outlines_view->setDocument(novel_core->volumeOutlinesPresent());
+    volume_outlines_view->setEnabled(true);
 
     get_view_according_name(DESPLINES_SUM_UNDER_VOLUME)->setEnabled(true);
     get_view_according_name(DESPLINES_SUM_UNTIL_VOLUME)->setEnabled(true);
@@ -1943,7 +2048,7 @@ void MainFrame::append_despline_from_desplineview()
 
     novel_core->appendDesplineUnderCurrentVolume(title, desp);
 
-    refresh_desplineview();
+    resize_foreshadows_tableitem_width();
 }
 
 void MainFrame::remove_despline_from_desplineview(QTreeView *view)
@@ -1959,7 +2064,6 @@ void MainFrame::remove_despline_from_desplineview(QTreeView *view)
 
     try {
         novel_core->removeDespline(id_index.data(Qt::UserRole+1).toInt());
-        view->model()->removeRow(disp_index.row(), disp_index.parent());
     } catch (WsException *e) {
         QMessageBox::critical(this, "移除支线", e->reason());
     }
@@ -1989,7 +2093,7 @@ void MainFrame::append_attachpoint_from_desplineview(QTreeView *view)
         novel_core->insertAttachpoint(despline_id.data(Qt::UserRole+1).toInt(), title, desp);
     }
 
-    refresh_desplineview(view);
+    resize_foreshadows_tableitem_width();
 }
 
 void MainFrame::insert_attachpoint_from_desplineview(QTreeView *widget)
@@ -2009,7 +2113,7 @@ void MainFrame::insert_attachpoint_from_desplineview(QTreeView *widget)
     auto despline_id = disp_index.parent().sibling(disp_index.parent().row(), 1);
     novel_core->insertAttachpoint(despline_id.data(Qt::UserRole+1).toInt(), title, desp, id_index.data().toInt());
 
-    refresh_desplineview(widget);
+    resize_foreshadows_tableitem_width();
 }
 
 void MainFrame::remove_attachpoint_from_desplineview(QTreeView *widget)
@@ -2025,7 +2129,6 @@ void MainFrame::remove_attachpoint_from_desplineview(QTreeView *widget)
 
     try {
         novel_core->removeAttachpoint(id_index.data(Qt::UserRole+1).toInt());
-        widget->model()->removeRow(disp_index.row(), disp_index.parent());
     } catch (WsException *e) {
         QMessageBox::critical(this, "移除驻点", e->reason());
     }
@@ -2131,7 +2234,95 @@ int MainFrame::getDescription(const QString &title, QString &nameOut, QString &d
 // ==================================================================================================================================
 // ==================================================================================================================================
 
-CQTextEdit::CQTextEdit(ConfigHost &config, QWidget *parent):QTextEdit(parent),host(config){}
+CQTextEdit::CQTextEdit(ConfigHost &config, QWidget *parent)
+    :QTextEdit(parent),host(config),keywords_completer(new QCompleter(this)),
+      completion_model(new QStringListModel(this)), completion_prefix_length(0)
+{
+    keywords_completer->setWidget(this);
+    keywords_completer->setModel(completion_model);
+    keywords_completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    connect(keywords_completer, QOverload<const QString &>::of(&QCompleter::activated),
+            this,   &CQTextEdit::insert_completion);
+}
+
+void CQTextEdit::keyPressEvent(QKeyEvent *event)
+{
+    // 补全弹窗可见时，取消按键交由补全器处理；确认按键仅在用户已选中候选时交由补全器，否则照常输入
+    auto popup = keywords_completer->popup();
+    if(popup->isVisible()){
+        switch (event->key()) {
+            case Qt::Key_Escape:
+                event->ignore();
+                return;
+            case Qt::Key_Enter:
+            case Qt::Key_Return:
+            case Qt::Key_Tab:
+            case Qt::Key_Backtab:
+                if(popup->currentIndex().isValid()){
+                    event->ignore();
+                    return;
+                }
+                popup->hide();
+                break;
+            default:
+                break;
+        }
+    }
+
+    QTextEdit::keyPressEvent(event);
+    if(event->text().isEmpty() && event->key() != Qt::Key_Backspace){
+        keywords_completer->popup()->hide();
+        return;
+    }
+    refresh_completion();
+}
+
+void CQTextEdit::inputMethodEvent(QInputMethodEvent *event)
+{
+    QTextEdit::inputMethodEvent(event);
+    if(!event->commitString().isEmpty())
+        refresh_completion();
+}
+
+void CQTextEdit::refresh_completion()
+{
+    const int max_suffix = 8, topk = 12;
+
+    auto cursor = textCursor();
+    auto block_text = cursor.block().text().left(cursor.positionInBlock());
+    // 单字后缀在中文正文中几乎处处命中，至少两字才提示
+    for (auto length=qMin(max_suffix, block_text.length()); length>1; --length) {
+        auto suffix = block_text.right(length);
+        if(suffix.at(0).isSpace())
+            continue;
+
+        auto candidates = host.keywordsCompletion(suffix, topk);
+        candidates.removeAll(suffix);
+        if(candidates.isEmpty())
+            continue;
+
+        completion_prefix_length = length;
+        completion_model->setStringList(candidates);
+
+        auto rect = cursorRect();
+        rect.setWidth(keywords_completer->popup()->sizeHintForColumn(0)
+                      + keywords_completer->popup()->verticalScrollBar()->sizeHint().width());
+        keywords_completer->complete(rect);
+        keywords_completer->popup()->setCurrentIndex(QModelIndex());
+        return;
+    }
+
+    keywords_completer->popup()->hide();
+}
+
+void CQTextEdit::insert_completion(const QString &words)
+{
+    auto cursor = textCursor();
+    cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor, completion_prefix_length);
+    cursor.insertText(words);
+    setTextCursor(cursor);
+    keywords_completer->popup()->hide();
+}
 
 void CQTextEdit::insertFromMimeData(const QMimeData *source)
 {
@@ -2449,8 +2640,34 @@ QWidget *ValueAssignDelegate::createEditor(QWidget *parent, const QStyleOptionVi
                     case KfvType::NUMBER:
                         return new QDoubleSpinBox(parent);
                     case KfvType::ENUM:
-                    case KfvType::TABLEREF:
                         return new QComboBox(parent);
+                    case KfvType::TABLEREF:{
+                            // 可编辑增量检索：输入片段即时重填候选，编辑器存续期间仅连接一次
+                            auto ed2 = new QComboBox(parent);
+                            ed2->setEditable(true);
+                            ed2->setInsertPolicy(QComboBox::NoInsert);
+
+                            auto host_ptr = host;
+                            QPersistentModelIndex target(index);
+                            auto refill = [host_ptr, ed2, target](const QString &fragment){
+                                if(!target.isValid())
+                                    return;
+                                auto cursor_pos = ed2->lineEdit()->cursorPosition();
+                                ed2->blockSignals(true);
+                                ed2->clear();
+                                for (auto pair : host_ptr->searchItemsForIndex(target, fragment, 64))
+                                    ed2->addItem(pair.second, pair.first);
+                                ed2->setEditText(fragment);
+                                ed2->lineEdit()->setCursorPosition(cursor_pos);
+                                ed2->blockSignals(false);
+                            };
+                            // 初始候选不按当前值过滤，当前值为空或失效时同样可选
+                            WsExcept(refill(QString()));
+                            connect(ed2, &QComboBox::editTextChanged, ed2, [refill](const QString &text){
+                                WsExcept(refill(text));
+                            });
+                            return ed2;
+                        }
                 }
             }break;
     }
@@ -2486,11 +2703,9 @@ void ValueAssignDelegate::setEditorData(QWidget *editor, const QModelIndex &inde
                         }break;
                     case KfvType::TABLEREF:{
                             auto ed2 = static_cast<QComboBox*>(editor);
-                            auto items = host->avaliableItemsForIndex(index);
-                            for (auto pair : items) {
-                                ed2->addItem(pair.second, pair.first);
-                            }
-                            ed2->setCurrentText(index.data().toString());
+                            ed2->blockSignals(true);
+                            ed2->setEditText(index.data().toString());
+                            ed2->blockSignals(false);
                         }break;
                 }
             }break;
@@ -2515,12 +2730,18 @@ void ValueAssignDelegate::setModelData(QWidget *editor, QAbstractItemModel *mode
                             auto ed2 = static_cast<QDoubleSpinBox*>(editor);
                             model->setData(index, ed2->value(), Qt::UserRole+1);
                         }break;
-                    case KfvType::ENUM:
-                    case KfvType::TABLEREF:{
+                    case KfvType::ENUM:{
                             auto ed2 = static_cast<QComboBox*>(editor);
                             auto num = ed2->currentData().toInt();
                             model->setData(index, num, Qt::UserRole+1);
                         }break;
+                    case KfvType::TABLEREF:{
+                            auto ed2 = static_cast<QComboBox*>(editor);
+                            auto item_index = ed2->findText(ed2->currentText());
+                            if(item_index < 0)
+                                return;
+                            model->setData(index, ed2->itemData(item_index).toInt(), Qt::UserRole+1);
+                        }break;
                 }
             }break;
     }
@@ -2788,6 +3009,19 @@ void TaskReport::increaseTaskCount(const QString &taskMark, int num)
     task_switch->setCurrentText(taskMark);
 }
 
+void TaskReport::updateTaskProgress(const QString &taskMark, int done, int total)
+{
+    QMutexLocker locker(lock_ins);
+
+    if(!tasks_hold.contains(taskMark) || total <= 0)
+        return;
+
+    auto exists = tasks_hold.value(taskMark);
+    std::get<0>(exists)->setText(QString("%1(%2/%3) %4/%5").arg(taskMark).arg(std::get<2>(exists))
+                                 .arg(std::get<3>(exists)).arg(done).arg(total));
+    std::get<1>(exists)->setValue(100 * (done*1.0/total));
+}
+
 void TaskReport::reduceTaskCount(const QString &taskMark, const QString &finalTips, int num)
 {
     QMutexLocker locker(lock_ins);
@@ -5,6 +5,7 @@
 #include "novelhost.h"
 
 #include <QComboBox>
+#include <QCompleter>
 #include <QDialog>
 #include <QGridLayout>
 #include <QMainWindow>
@@ -18,6 +19,7 @@
 #include <QLabel>
 #include <QProgressBar>
 #include <QStatusBar>
+#include <QStringListModel>
 
 class MainFrame;
 
@@ -31,8 +33,22 @@ namespace WidgetBase {
     protected:
         virtual void insertFromMimeData(const QMimeData *source) override;
 
+        // QWidget interface
+    protected:
+        virtual void keyPressEvent(QKeyEvent *event) override;
+        virtual void inputMethodEvent(QInputMethodEvent *event) override;
+
     private:
         ConfigHost &host;
+        QCompleter *const keywords_completer;
+        QStringListModel *const completion_model;
+        int completion_prefix_length;
+
+        /**
+         * @brief 以光标前文本的各级后缀查询关键字补全，优先采用最长的命中后缀
+         */
+        void refresh_completion();
+        void insert_completion(const QString &words);
     };
 
     class FieldsAdjustDialog : public QDialog
@@ -176,6 +192,10 @@ namespace WidgetBase {
 
         void increaseTaskCount(const QString &taskMark, int num=1);
         void reduceTaskCount(const QString &taskMark, const QString &finalTips, int num=1);
+        /**
+         * @brief 单项任务的细分进度，显示于该任务的进度条
+         */
+        void updateTaskProgress(const QString &taskMark, int done, int total);
     private:
         QMutex *const lock_ins;
         QComboBox *const task_switch;
@@ -215,6 +235,7 @@ private:
     QWidget *group_keywords_manager_view(NovelHost *novel_core);
     QWidget *group_keywords_quicklook_view(QAbstractItemModel *model);
     QWidget *group_search_result_summary_panel();
+    QWidget *group_desplines_coverage_panel();
     WidgetBase::CQTextEdit *group_textedit_view(QTextDocument *doc);
 
 
@@ -287,6 +308,7 @@ private:
     void remove_selected_outlines();
 
     void saveOp();
+    void backupOp();
     void autosave_timespan_reset();
 
     void documentClosed(QTextDocument *);
@@ -3,15 +3,23 @@
 #include "novelhost.h"
 
 #include <QApplication>
+#include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
 #include <QStyle>
 #include <QTextCodec>
 #include <QTextCursor>
 #include <QTextDocument>
 #include <QTextFrame>
+#include <QThread>
 #include <QThreadPool>
 #include <QtDebug>
+#include <algorithm>
+#include <limits>
 
 using namespace NovelBase;
 using TnType = DBAccess::StoryTreeNode::Type;
@@ -30,11 +38,13 @@ NovelHost::NovelHost(ConfigHost &config)
       desplines_filter_until_volume_remain(new DesplineFilterModel(DesplineFilterModel::Type::UNTILWITHVOLUME, this)),
       desplines_filter_until_chapter_remain(new DesplineFilterModel(DesplineFilterModel::Type::UNTILWITHCHAPTER, this)),
       find_results_model(new QStandardItemModel(this)),
+      desplines_coverage_model(new QStandardItemModel(this)),
+      description_write_behind(new WriteBehindBuffer(1500, this)),
       keywords_types_configmodel(new QStandardItemModel(this)),
+      mentions_reindex_timer(new QTimer(this)),
+      mentions_slice_timer(new QTimer(this)),
       quicklook_backend_model(new QStandardItemModel(this))
 {
-    new OutlinesRender(volume_outlines_present, config);
-
     connect(outline_navigate_treemodel, &QStandardItemModel::itemChanged,
             this,   &NovelHost::outlines_node_title_changed);
     connect(chapters_navigate_treemodel,&QStandardItemModel::itemChanged,
@@ -43,9 +53,19 @@ NovelHost::NovelHost(ConfigHost &config)
     desplines_filter_under_volume->setSourceModel(desplines_fuse_source_model);
     desplines_filter_until_volume_remain->setSourceModel(desplines_fuse_source_model);
     desplines_filter_until_chapter_remain->setSourceModel(desplines_fuse_source_model);
+    desplines_filter_under_volume->setSummaryIndex(&despline_summaries);
+    desplines_filter_until_volume_remain->setSummaryIndex(&despline_summaries);
+    desplines_filter_until_chapter_remain->setSummaryIndex(&despline_summaries);
 
     connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
             this,                           &NovelHost::_listen_basic_datamodel_changed);
+
+    mentions_reindex_timer->setSingleShot(true);
+    mentions_reindex_timer->setInterval(2000);
+    connect(mentions_reindex_timer, &QTimer::timeout,   this,   &NovelHost::_flush_dirty_mentions);
+    mentions_slice_timer->setSingleShot(true);
+    mentions_slice_timer->setInterval(0);
+    connect(mentions_slice_timer,   &QTimer::timeout,   this,   &NovelHost::_process_mentions_slice);
 }
 
 NovelHost::~NovelHost(){}
@@ -54,6 +74,12 @@ void NovelHost::loadBase(DBAccess *desp)
 {
     // save description structure
     this->desp_ins = desp;
+    description_write_behind->resetAccessBase(desp);
+    connect(desp_ins,   &DBAccess::keywordsRecordsChanged,  this,   &NovelHost::reset_quicklook_model);
+    connect(desp_ins,   &DBAccess::keywordRecordChanged,    this,   &NovelHost::patch_quicklook_model);
+    // 关键字登记变化后延迟重建提及索引
+    connect(desp_ins,   &DBAccess::keywordsRecordsChanged,  mentions_reindex_timer,   static_cast<void(QTimer::*)()>(&QTimer::start));
+    connect(desp_ins,   &DBAccess::keywordRecordChanged,    mentions_reindex_timer,   static_cast<void(QTimer::*)()>(&QTimer::start));
     chapters_navigate_treemodel->setHorizontalHeaderLabels(QStringList() << "章卷名称" << "严格字数统计");
     outline_navigate_treemodel->setHorizontalHeaderLabels(QStringList() << "故事结构");
 
@@ -71,65 +97,27 @@ void NovelHost::loadBase(DBAccess *desp)
     novel_outlines_present->clearUndoRedoStacks();
     connect(novel_outlines_present,  &QTextDocument::contentsChanged,    this,   &NovelHost::listen_novel_description_change);
 
-    auto volume_num = novel_node.childCount(TnType::VOLUME);
-    for (int volume_index = 0; volume_index < volume_num; ++volume_index) {
-        DBAccess::StoryTreeNode volume_node = novel_node.childAt(TnType::VOLUME, volume_index);
-
-        // 在chapters-tree和outline-tree上插入卷节点
-        auto pair = insert_volume(volume_node, volume_index);
-        auto outline_volume_node = pair.first;
-        auto node_navigate_volume_node = pair.second;
-
-        int storyblock_count = volume_node.childCount(TnType::STORYBLOCK);
-        for (int storyblock_index = 0; storyblock_index < storyblock_count; ++storyblock_index) {
-            DBAccess::StoryTreeNode storyblock_node = volume_node.childAt(TnType::STORYBLOCK, storyblock_index);
-
-            // outline-tree上插入故事节点
-            auto ol_keystory_item = new OutlinesItem(storyblock_node);
-            outline_volume_node->appendRow(ol_keystory_item);
-
-            // outline-tree上插入point节点
-            int points_count = storyblock_node.childCount(TnType::KEYPOINT);
-            for (int points_index = 0; points_index < points_count; ++points_index) {
-                DBAccess::StoryTreeNode point_node = storyblock_node.childAt(TnType::KEYPOINT, points_index);
-
-                auto outline_point_node = new OutlinesItem(point_node);
-                ol_keystory_item->appendRow(outline_point_node);
-            }
-        }
-
-        // chapters上插入chapter节点
-        int chapter_count = volume_node.childCount(TnType::CHAPTER);
-        for (int chapter_index = 0; chapter_index < chapter_count; ++chapter_index) {
-            auto chapter_node = volume_node.childAt(TnType::CHAPTER, chapter_index);
-
-            QList<QStandardItem*> node_navigate_row;
-            node_navigate_row << new ChaptersItem(*this, chapter_node);
-            node_navigate_row << new QStandardItem("-");
-            node_navigate_row.last()->setEditable(false);
-
-            node_navigate_volume_node->appendRow(node_navigate_row);
-        }
-    }
+    // 单次查询构建chapters-tree和outline-tree
+    build_navigate_trees();
 
-    // 加载所有内容
-    for(int index=0; index<chapters_navigate_treemodel->rowCount(); ++index) {
-        auto column = chapters_navigate_treemodel->item(index);
-        for (int chp_var = 0; chp_var < column->rowCount(); ++chp_var) {
-            auto chp_item = column->child(chp_var);
-            load_chapter_text_content(chp_item);
-        }
-    }
+    // 章节正文在首次打开时载入，未载入章节显示存储字数
+    chapter_words_stored = desp_ins->chaptersWordsCount();
     refreshDesplinesSummary();
     _load_all_keywords_types_only_once();
+    // 提及索引于事件循环空隙分片建立，不占用加载过程
+    mentions_keywords = config_host.registeredKeywords();
+    for (auto chapter : chapters_items_index) {
+        if(chapter->nodeType() == TnType::CHAPTER)
+            _enqueue_chapter_mentions(chapter->uniqueID());
+    }
 }
 
 void NovelHost::save()
 {
-    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
+    description_write_behind->flush();
+
     for (auto vm_index=0; vm_index<chapters_navigate_treemodel->rowCount(); ++vm_index) {
         auto volume_node = static_cast<ChaptersItem*>(chapters_navigate_treemodel->item(vm_index));
-        auto struct_volume_handle = storytree_hdl.novelNode().childAt(TnType::VOLUME, volume_node->row());
 
         for (auto chp_index=0; chp_index<volume_node->rowCount(); ++chp_index) {
             auto chapter_node = static_cast<ChaptersItem*>(volume_node->child(chp_index));
@@ -137,12 +125,34 @@ void NovelHost::save()
             auto pak = all_documents.value(chapter_node);
             // 检测文件是否修改
             if(all_documents.contains(chapter_node) && pak.first->isModified()){
-                auto struct_chapter_handle = struct_volume_handle.childAt(TnType::CHAPTER, chapter_node->row());
-                desp_ins->resetChapterText(struct_chapter_handle, pak.first->toPlainText());
+                auto struct_chapter_handle = _locate_chapters_handle_via(chapter_node);
+                auto content = pak.first->toPlainText();
+                store_chapter_text(struct_chapter_handle, content);
+                desp_ins->appendChapterRevision(struct_chapter_handle, content);
                 pak.first->setModified(false);
             }
         }
     }
+
+    desp_ins->collectRevisionChunks();
+}
+
+void NovelHost::backupTo(const QString &targetDir, int generations)
+{
+    if(!desp_ins)
+        throw new WsException("尚未载入作品");
+
+    auto worker = new BackupWorker(desp_ins->filePath(), targetDir, generations);
+    connect(worker, &BackupWorker::backupProgress,  this,   [this](int copiedRows, int totalRows){
+        emit taskProgress("在线备份", copiedRows, totalRows);
+    }, Qt::QueuedConnection);
+    connect(worker, &BackupWorker::backupFinished,  this,   [this](bool success, const QString &message){
+        finishActiveTask("在线备份", message);
+        if(!success)
+            emit warningPopup("在线备份", message);
+    }, Qt::QueuedConnection);
+    appendActiveTask("在线备份");
+    QThreadPool::globalInstance()->start(worker);
 }
 
 QString NovelHost::novelTitle() const
@@ -211,6 +221,10 @@ void NovelHost::insertVolume(const QString &name, const QString &description, in
 
     auto vnode = storytree_hdl.insertChildNodeBefore(root, TnType::VOLUME, index, name, description);
     insert_volume(vnode, index);
+    despline_coverage.clear();
+    // 中间插入卷宗改变后续卷宗序号
+    if(index < count)
+        refreshDesplinesSummary();
 }
 
 void NovelHost::insertStoryblock(const QModelIndex &pIndex, const QString &name, const QString &description, int index)
@@ -222,21 +236,24 @@ void NovelHost::insertStoryblock(const QModelIndex &pIndex, const QString &name,
 
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     QStandardItem *item = outline_navigate_treemodel->item(pIndex.row());
-    auto root = storytree_hdl.novelNode();
-    auto volume_struct_node = root.childAt(TnType::VOLUME, item->row());
+    auto volume_struct_node = _locate_outline_handle_via(item);
 
+    OutlinesItem *keystory_item;
     int sb_node_count = volume_struct_node.childCount(TnType::STORYBLOCK);
     if(index < 0 || index >= sb_node_count){
         auto keystory_node = storytree_hdl.insertChildNodeBefore(volume_struct_node, TnType::STORYBLOCK,
                                                                       sb_node_count, name, description);
-        item->appendRow(new OutlinesItem(keystory_node));
+        keystory_item = new_outlines_item(keystory_node);
+        item->appendRow(keystory_item);
         index = sb_node_count;
     }
     else{
         auto keystory_node = storytree_hdl.insertChildNodeBefore(volume_struct_node, TnType::STORYBLOCK,
                                                                       index, name, description);
-        item->insertRow(index, new OutlinesItem(keystory_node));
+        keystory_item = new_outlines_item(keystory_node);
+        item->insertRow(index, keystory_item);
     }
+    patch_volume_outlines_insert(keystory_item, description);
 
     setCurrentOutlineNode(outline_navigate_treemodel->index(index, 0, pIndex));
 }
@@ -252,18 +269,22 @@ void NovelHost::insertKeypoint(const QModelIndex &pIndex, const QString &name, c
     auto node = outline_navigate_treemodel->itemFromIndex(pIndex);          // keystory-index
     auto struct_storyblock_node = _locate_outline_handle_via(node);
 
+    OutlinesItem *point_item;
     int points_count = struct_storyblock_node.childCount(TnType::KEYPOINT);
     if(index<0 || index >= points_count){
         auto point_node = storytree_hdl.insertChildNodeBefore(struct_storyblock_node, TnType::KEYPOINT,
                                                                    points_count, name, description);
-        node->appendRow(new OutlinesItem(point_node));
+        point_item = new_outlines_item(point_node);
+        node->appendRow(point_item);
         index = points_count;
     }
     else{
         auto point_node = storytree_hdl.insertChildNodeBefore(struct_storyblock_node, TnType::KEYPOINT,
                                                                    index, name, description);
-        node->insertRow(index, new OutlinesItem(point_node));
+        point_item = new_outlines_item(point_node);
+        node->insertRow(index, point_item);
     }
+    patch_volume_outlines_insert(point_item, description);
 
     setCurrentOutlineNode(outline_navigate_treemodel->index(index, 0, pIndex));
 }
@@ -276,11 +297,11 @@ void NovelHost::appendDesplineUnder(const QModelIndex &anyVolumeIndex, const QSt
         throw new WsException("输入index类型错误");
 
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
-    auto root = storytree_hdl.novelNode();
-    auto struct_volume_node = root.childAt(TnType::VOLUME, anyVolumeIndex.row());
+    auto struct_volume_node = _locate_chapters_handle_via(chapters_navigate_treemodel->item(anyVolumeIndex.row()));
 
     auto despline_count = struct_volume_node.childCount(TnType::DESPLINE);
-    storytree_hdl.insertChildNodeBefore(struct_volume_node, TnType::DESPLINE, despline_count, name, description);
+    auto despline = storytree_hdl.insertChildNodeBefore(struct_volume_node, TnType::DESPLINE, despline_count, name, description);
+    insert_despline_summary(despline, struct_volume_node, anyVolumeIndex.row());
 }
 
 void NovelHost::appendDesplineUnderCurrentVolume(const QString &name, const QString &description)
@@ -290,7 +311,8 @@ void NovelHost::appendDesplineUnderCurrentVolume(const QString &name, const QStr
 
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     auto despline_count = current_volume_node.childCount(TnType::DESPLINE);
-    storytree_hdl.insertChildNodeBefore(current_volume_node, TnType::DESPLINE, despline_count, name, description);
+    auto despline = storytree_hdl.insertChildNodeBefore(current_volume_node, TnType::DESPLINE, despline_count, name, description);
+    insert_despline_summary(despline, current_volume_node, current_volume_node.index());
 }
 
 void NovelHost::removeDespline(int desplineID)
@@ -306,6 +328,19 @@ void NovelHost::removeDespline(int desplineID)
         throw new WsException("目标支线非悬空支线，无法删除！");
 
     storytree_hdl.removeNode(despline);
+
+    despline_summaries.remove(desplineID);
+    despline_coverage.removeDespline(desplineID);
+    auto item = despline_summary_items.take(desplineID);
+    if(!item)
+        return;
+    auto volume_index = item->data(Qt::UserRole+2).toInt();
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
+    desplines_fuse_source_model->removeRow(item->row());
+    renumber_desplines_summary(volume_index);
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
 }
 
 void NovelHost::removeOutlinesNode(const QModelIndex &outlineNode)
@@ -316,24 +351,26 @@ void NovelHost::removeOutlinesNode(const QModelIndex &outlineNode)
     // 转移焦点
 
 
-    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     auto item = outline_navigate_treemodel->itemFromIndex(outlineNode);
     int row = item->row();
 
     if(indexDepth(outlineNode) == 1){
-        auto root = storytree_hdl.novelNode();
-        auto struct_node = root.childAt(TnType::VOLUME, row);
-
-        outline_navigate_treemodel->removeRow(row);
-        chapters_navigate_treemodel->removeRow(row);
-
-        storytree_hdl.removeNode(struct_node);
+        remove_volume_node(row);
     }
     else {
+        DBAccess::StoryTreeController storytree_hdl(*desp_ins);
         auto handle = _locate_outline_handle_via(item);
-        item->parent()->removeRow(row);
+        description_write_behind->flush();
 
+        QList<QPair<int, QString>> desplines;
+        QList<DBAccess::StoryTreeController::PointImpact> points;
+        storytree_hdl.removeImpactOf(handle, desplines, points);
         storytree_hdl.removeNode(handle);
+
+        patch_volume_outlines_remove(static_cast<OutlinesItem*>(item));
+        forget_navigate_items(item);
+        item->parent()->removeRow(row);
+        drop_removed_desplines_summary(desplines, points, -1);
     }
 }
 
@@ -367,18 +404,7 @@ void NovelHost::checkChaptersRemoveEffect(const QModelIndex &chpsIndex, QList<QS
     if(!chpsIndex.isValid() || chpsIndex.model()!=chapters_navigate_treemodel)
         throw new WsException("指定index无效");
 
-    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
-    DBAccess::StoryTreeNode struct_node;
-    switch (indexDepth(chpsIndex)) {
-        case 1:
-            struct_node = storytree_hdl.novelNode().childAt(TnType::VOLUME, chpsIndex.row());
-            break;
-        case 2:
-            struct_node = storytree_hdl.novelNode().childAt(TnType::VOLUME, chpsIndex.parent().row());
-            struct_node = struct_node.childAt(TnType::CHAPTER, chpsIndex.row());
-            break;
-    }
-
+    auto struct_node = _locate_chapters_handle_via(chapters_navigate_treemodel->itemFromIndex(chpsIndex));
     _check_remove_effect(struct_node, msgList);
 }
 
@@ -402,52 +428,111 @@ void NovelHost::checkOutlinesRemoveEffect(const QModelIndex &outlinesIndex, QLis
     _check_remove_effect(struct_node, msgList);
 }
 
-DBAccess::StoryTreeNode NovelHost:: _locate_outline_handle_via(QStandardItem *outline_item) const
+OutlinesItem *NovelHost::new_outlines_item(const DBAccess::StoryTreeNode &node)
 {
-    QList<QStandardItem*> stack;
-    while (outline_item) {
-        stack.insert(0, outline_item);
-        outline_item = outline_item->parent();
-    }
+    auto item = new OutlinesItem(node);
+    outline_items_index.insert(node.uniqueID(), item);
+    return item;
+}
 
+void NovelHost::build_navigate_trees()
+{
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
-    auto root = storytree_hdl.novelNode();
-    auto volume_node = root.childAt(TnType::VOLUME, stack.at(0)->row());
-    if(stack.size() == 1){
-        return volume_node;
-    }
+    auto skeleton = storytree_hdl.navigateSkeleton();
+
+    for (auto &node : skeleton) {
+        switch (node.type) {
+            case TnType::VOLUME:{
+                    auto outline_volume = new OutlinesItem(node.id, node.type, node.title);
+                    outline_items_index.insert(node.id, outline_volume);
+                    outline_navigate_treemodel->appendRow(outline_volume);
+
+                    auto chapters_volume = new ChaptersItem(*this, node.id, node.type, node.title);
+                    chapters_items_index.insert(node.id, chapters_volume);
+                    chapters_navigate_treemodel->appendRow(QList<QStandardItem*>() << chapters_volume << new WordsCountItem(*this));
+                }
+                break;
+            case TnType::CHAPTER:{
+                    auto volume = chapters_items_index.value(node.parent);
+                    if(!volume)
+                        break;
+
+                    auto chapter = new ChaptersItem(*this, node.id, node.type, node.title);
+                    chapters_items_index.insert(node.id, chapter);
+                    volume->appendRow(QList<QStandardItem*>() << chapter << new WordsCountItem(*this));
+                }
+                break;
+            default:{   // 剧情与分解点
+                    auto parent = outline_items_index.value(node.parent);
+                    if(!parent)
+                        break;
 
-    auto keystory_node = volume_node.childAt(TnType::STORYBLOCK, stack.at(1)->row());
-    if(stack.size() == 2){
-        return keystory_node;
+                    auto item = new OutlinesItem(node.id, node.type, node.title);
+                    outline_items_index.insert(node.id, item);
+                    parent->appendRow(item);
+                }
+                break;
+        }
     }
+}
+
+ChaptersItem *NovelHost::new_chapters_item(const DBAccess::StoryTreeNode &node, bool isGroup)
+{
+    auto item = new ChaptersItem(*this, node, isGroup);
+    chapters_items_index.insert(node.uniqueID(), item);
+    return item;
+}
+
+void NovelHost::forget_navigate_items(QStandardItem *item)
+{
+    for (int row=0; row<item->rowCount(); ++row)
+        forget_navigate_items(item->child(row));
+
+    if(item->model() == outline_navigate_treemodel)
+        outline_items_index.remove(static_cast<OutlinesItem*>(item)->uniqueID());
+    else if(item->model() == chapters_navigate_treemodel)
+        chapters_items_index.remove(static_cast<ChaptersItem*>(item)->uniqueID());
+}
+
+DBAccess::StoryTreeNode NovelHost:: _locate_outline_handle_via(QStandardItem *outline_item) const
+{
+    auto item = static_cast<OutlinesItem*>(outline_item);
+    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
+    return storytree_hdl.nodeOf(item->uniqueID(), item->nodeType());
+}
+
+DBAccess::StoryTreeNode NovelHost::_locate_chapters_handle_via(QStandardItem *chapters_item) const
+{
+    // 计数列不是章卷条目
+    if(chapters_item->column())
+        chapters_item = chapters_item->parent()? chapters_item->parent()->child(chapters_item->row())
+                                               : chapters_navigate_treemodel->item(chapters_item->row());
 
-    auto point_node = keystory_node.childAt(TnType::KEYPOINT, stack.at(2)->row());
-    return point_node;
+    auto item = static_cast<ChaptersItem*>(chapters_item);
+    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
+    return storytree_hdl.nodeOf(item->uniqueID(), item->nodeType());
 }
 
 void NovelHost::listen_volume_outlines_description_change(int pos, int removed, int added)
 {
+    reown_volume_outlines_blocks(pos, added);
+    volume_outlines_last_change = qMakePair(pos, added);
+
     // 输入法更新期间，数据无用
     if(removed == added)
         return;
 
     // 查询内容修改
-    QTextCursor cursor(volume_outlines_present);
-    cursor.setPosition(pos);
-
-    auto current_block = cursor.block();
-    auto title_block = current_block;
-    while (title_block.isValid()) {
-        if(title_block.userData())
-            break;
-        title_block = title_block.previous();
-    }
+    auto current_block = volume_outlines_present->findBlock(pos);
+    auto title_item = outline_items_index.value(current_block.userState());
+    if(!title_item)
+        return;
+    auto title_block = volume_outlines_title_block(volume_outlines_present, title_item);
+    if(!title_block.isValid())
+        return;
 
     if(current_block == title_block){
-        auto data = static_cast<WsBlockData*>(title_block.userData());
-        auto index = data->navigateIndex();
-        auto title_item = outline_navigate_treemodel->itemFromIndex(index);
+        auto index = title_item->index();
         if(title_block.text() == ""){
             emit errorPopup("编辑操作", "标题为空，继续删除将破坏文档结构");
         }
@@ -470,86 +555,105 @@ void NovelHost::listen_volume_outlines_description_change(int pos, int removed,
             block = block.next();
         }
 
-        DBAccess::StoryTreeController storytree_hdl(*desp_ins);
-        auto index = static_cast<WsBlockData*>(title_block.userData())->navigateIndex();
-        auto title_item = outline_navigate_treemodel->itemFromIndex(index);
         auto struct_node = _locate_outline_handle_via(title_item);
-        storytree_hdl.resetDescriptionOf(struct_node, description);
+        description_write_behind->postValue(struct_node, WriteBehindBuffer::Field::DESCRIPTION, description);
     }
 }
 
-bool NovelHost::check_volume_structure_diff(const OutlinesItem *base_node, QTextBlock &blk) const {
-    auto target_index = base_node->index();
-    while (blk.isValid()) {
+void NovelHost::reown_volume_outlines_blocks(int pos, int added)
+{
+    auto blk = volume_outlines_present->findBlock(pos);
+    auto owner = blk.userState();
+    for (auto prev = blk.previous(); owner < 0 && prev.isValid(); prev = prev.previous())
+        owner = prev.userState();
+
+    auto end_block = volume_outlines_present->findBlock(qMin(pos + added, volume_outlines_present->characterCount() - 1));
+    for (; blk.isValid(); blk = blk.next()) {
         if(blk.userData())
+            owner = blk.userState();
+        else
+            blk.setUserState(owner);
+
+        if(blk == end_block)
             break;
-        blk = blk.next();
     }
-    if(!blk.isValid())
-        return false;
+}
 
-    auto user_data = static_cast<WsBlockData*>(blk.userData());
-    auto title_index = user_data->navigateIndex();
-    if(target_index != title_index)
+bool NovelHost::check_volume_structure_diff(int pos, int added)
+{
+    // 变更区段所属节点的标题块须存在，其后首个标题块须为该节点的先序后继
+    auto first_block = volume_outlines_present->findBlock(pos);
+    auto owner = outline_items_index.value(first_block.userState());
+    if(!owner || !volume_outlines_title_block(volume_outlines_present, owner).isValid())
         return true;
 
-    blk = blk.next();
-    for (int var = 0; var < base_node->rowCount(); ++var) {
-        auto item = base_node->child(var);
-        if(check_volume_structure_diff(static_cast<OutlinesItem*>(item), blk))
-            return true;
-    }
+    auto end_block = volume_outlines_present->findBlock(qMin(pos + added, volume_outlines_present->characterCount() - 1));
+    auto blk = first_block.next();
+    while (blk.isValid() && !blk.userData())
+        blk = blk.next();
+    if(blk.isValid() && end_block.isValid() && blk.position() < end_block.position())
+        return true;                        // 变更区段内不应新增标题块
 
-    return false;
+    auto expected = owner->rowCount()? owner->child(0): outlines_follower_of(owner);
+    if(!expected)
+        return blk.isValid();
+    return !blk.isValid() || blk.userState() != static_cast<OutlinesItem*>(expected)->uniqueID();
 }
 
 void NovelHost::listen_volume_outlines_structure_changed()
 {
-    int volume_index = current_volume_node.index();
-    auto volume_item = outline_navigate_treemodel->item(volume_index);
-    auto blk = volume_outlines_present->firstBlock();
-    auto outline_volume_item = static_cast<OutlinesItem*>(volume_item);
-
-    // 循环递归校验文档结构
-    if(check_volume_structure_diff(outline_volume_item, blk))
+    // 仅校验最近一次变更区段附近的结构
+    if(check_volume_structure_diff(volume_outlines_last_change.first, volume_outlines_last_change.second))
         emit errorPopup("文档编辑错误", "操作导致文档结构被破坏，请从故事树重新开始");
 }
 
 void NovelHost::listen_chapter_outlines_description_change()
 {
-    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     auto content = chapter_outlines_present->toPlainText();
-    storytree_hdl.resetDescriptionOf(current_chapter_node, content);
+    description_write_behind->postValue(current_chapter_node, WriteBehindBuffer::Field::DESCRIPTION, content);
 }
 
-void NovelHost::insert_description_at_volume_outlines_doc(QTextCursor cursor, OutlinesItem *outline_node)
+void NovelHost::insert_description_at_volume_outlines_doc(QTextCursor cursor, OutlinesItem *outline_node,
+                                                          const QHash<int, QString> &descriptions)
 {
-    auto struct_node = _locate_outline_handle_via(outline_node);
+    write_volume_outlines_section(cursor, outline_node, descriptions.value(outline_node->uniqueID()));
+    cursor.insertBlock();
+
+    for (int var=0; var < outline_node->rowCount(); ++var) {
+        auto child = outline_node->child(var);
+        insert_description_at_volume_outlines_doc(cursor, static_cast<OutlinesItem*>(child), descriptions);
+    }
+}
 
+void NovelHost::write_volume_outlines_section(QTextCursor &cursor, OutlinesItem *outline_node, const QString &description)
+{
     QTextBlockFormat title_block_format;
     QTextCharFormat title_char_format;
     WsBlockData *data = nullptr;
 
-    switch (struct_node.type()) {
+    switch (outline_node->nodeType()) {
         case TnType::VOLUME:
             config_host.volumeTitleFormat(title_block_format, title_char_format);
-            data = new WsBlockData(outline_node->index(), TnType::VOLUME);
+            data = new WsBlockData(TnType::VOLUME);
             break;
         case TnType::STORYBLOCK:
             config_host.storyblockTitleFormat(title_block_format, title_char_format);
-            data = new WsBlockData(outline_node->index(), TnType::STORYBLOCK);
+            data = new WsBlockData(TnType::STORYBLOCK);
             break;
         case TnType::KEYPOINT:
             config_host.keypointTitleFormat(title_block_format, title_char_format);
-            data = new WsBlockData(outline_node->index(), TnType::KEYPOINT);
+            data = new WsBlockData(TnType::KEYPOINT);
             break;
         default:
             break;
     }
+    auto node_id = outline_node->uniqueID();
     cursor.setBlockFormat(title_block_format);
     cursor.setBlockCharFormat(title_char_format);
-    cursor.insertText(struct_node.title());
+    cursor.insertText(outline_node->text());
     cursor.block().setUserData(data);
+    cursor.block().setUserState(node_id);
+    volume_outlines_titles[cursor.document()].insert(node_id, QTextCursor(cursor.block()));
 
     cursor.insertBlock();
     QTextBlockFormat text_block_format;
@@ -557,76 +661,241 @@ void NovelHost::insert_description_at_volume_outlines_doc(QTextCursor cursor, Ou
     config_host.textFormat(text_block_format, text_char_format);
     cursor.setBlockFormat(text_block_format);
     cursor.setBlockCharFormat(text_char_format);
-    cursor.insertText(struct_node.description());
-    cursor.insertBlock();
+    auto desp_block = cursor.block();
+    cursor.insertText(description);
+    for (; desp_block.isValid(); desp_block = desp_block.next()) {
+        desp_block.setUserState(node_id);
+        if(desp_block == cursor.block())
+            break;
+    }
+}
 
-    for (int var=0; var < outline_node->rowCount(); ++var) {
-        auto child = outline_node->child(var);
-        insert_description_at_volume_outlines_doc(cursor, static_cast<OutlinesItem*>(child));
+void NovelHost::volume_outlines_listening(bool enable)
+{
+    if(enable){
+        connect(volume_outlines_present, &QTextDocument::contentsChange,
+                this,   &NovelHost::listen_volume_outlines_description_change);
+        connect(volume_outlines_present,  &QTextDocument::blockCountChanged,
+                this,    &NovelHost::listen_volume_outlines_structure_changed);
+    }
+    else {
+        disconnect(volume_outlines_present,  &QTextDocument::contentsChange,
+                   this,   &NovelHost::listen_volume_outlines_description_change);
+        disconnect(volume_outlines_present,  &QTextDocument::blockCountChanged,
+                   this,    &NovelHost::listen_volume_outlines_structure_changed);
     }
 }
 
-// msgList : [type](target)<keys-to-target>msg-body
-void NovelHost::_check_remove_effect(const DBAccess::StoryTreeNode &target, QList<QString> &msgList) const
+QTextDocument *NovelHost::volume_outlines_doc(OutlinesItem *volume_item)
 {
-    if(target.type() == TnType::KEYPOINT)
+    auto volume_id = volume_item->uniqueID();
+    volume_outlines_lru.removeOne(volume_id);
+    volume_outlines_lru.prepend(volume_id);
+    if(volume_outlines_cache.contains(volume_id))
+        return volume_outlines_cache.value(volume_id);
+
+    // 整卷描述单次查询，标题取自大纲树
+    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
+    auto descriptions = storytree_hdl.descriptionsUnder(storytree_hdl.nodeOf(volume_id, TnType::VOLUME));
+
+    auto doc = new QTextDocument(this);
+    new OutlinesRender(doc, config_host);
+    QTextCursor cursor(doc);
+    insert_description_at_volume_outlines_doc(cursor, volume_item, descriptions);
+    doc->setModified(false);
+    doc->clearUndoRedoStacks();
+    volume_outlines_cache.insert(volume_id, doc);
+
+    // 保留最近使用的若干卷宗，当前卷宗位于首位不会被淘汰
+    while (volume_outlines_lru.size() > 8)
+        evict_volume_outlines(volume_outlines_lru.last());
+
+    return doc;
+}
+
+QTextDocument *NovelHost::cached_volume_outlines_of(QStandardItem *outline_item) const
+{
+    while (outline_item->parent())
+        outline_item = outline_item->parent();
+
+    return volume_outlines_cache.value(static_cast<OutlinesItem*>(outline_item)->uniqueID());
+}
+
+void NovelHost::evict_volume_outlines(int volumeID)
+{
+    volume_outlines_lru.removeOne(volumeID);
+    auto doc = volume_outlines_cache.take(volumeID);
+    if(!doc)
         return;
+    volume_outlines_titles.remove(doc);
 
-    DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
-    if(target.type() == TnType::DESPLINE) {
-        msgList << "[warring](foreshadow·despline)<"+target.title()+">指定伏笔[故事线]将被删除，请注意！";
-
-        auto stopnodes = branchattach_hdl.getPointsViaDespline(target);
-        for (auto dot : stopnodes) {
-            auto storyblk = dot.attachedStoryblock();
-            if(storyblk.isValid())
-                msgList << "[error](keystory·storyblock)<"+storyblk.title()+">影响关键剧情！请重写相关内容！";
-            auto chapter = dot.attachedChapter();
-            if(chapter.isValid())
-                msgList << "[error](chapter)<"+chapter.title()+">影响章节内容！请重写相关内容！";
+    // 当前卷宗文档被淘汰（卷宗删除），以空文档顶替
+    if(doc == volume_outlines_present){
+        volume_outlines_listening(false);
+        volume_outlines_present = new QTextDocument(this);
+        emit documentAboutToBoClosed(doc);
+    }
+    doc->deleteLater();
+}
+
+QStandardItem *NovelHost::outlines_follower_of(QStandardItem *outline_item) const
+{
+    // 先序遍历中紧随该子树之后的节点
+    while (outline_item->parent()) {
+        auto parent = outline_item->parent();
+        if(outline_item->row() + 1 < parent->rowCount())
+            return parent->child(outline_item->row() + 1);
+        outline_item = parent;
+    }
+    return nullptr;
+}
+
+QTextBlock NovelHost::volume_outlines_title_block(QTextDocument *doc, QStandardItem *outline_item)
+{
+    auto node_id = static_cast<OutlinesItem*>(outline_item)->uniqueID();
+    auto &titles = volume_outlines_titles[doc];
+    auto blk = titles.value(node_id).block();
+    if(blk.isValid() && blk.userData() && blk.userState() == node_id)
+        return blk;
+
+    // 索引失配（编辑破坏了标题块），回退逐块查找并修正索引
+    for (blk = doc->firstBlock(); blk.isValid(); blk = blk.next()) {
+        if(blk.userData() && blk.userState() == node_id){
+            titles.insert(node_id, QTextCursor(blk));
+            return blk;
         }
+    }
+    titles.remove(node_id);
+    return QTextBlock();
+}
+
+QTextBlock NovelHost::volumeOutlinesTitleBlock(const QModelIndex &outlineNode)
+{
+    if(!outlineNode.isValid() || outlineNode.model() != outline_navigate_treemodel)
+        throw new WsException("传入的outlinemodelindex无效");
+
+    auto item = outline_navigate_treemodel->itemFromIndex(outlineNode);
+    if(cached_volume_outlines_of(item) != volume_outlines_present)
+        return QTextBlock();
+    return volume_outlines_title_block(volume_outlines_present, item);
+}
+
+void NovelHost::patch_volume_outlines_insert(OutlinesItem *outline_node, const QString &description)
+{
+    auto doc = cached_volume_outlines_of(outline_node);
+    if(!doc)
         return;
+
+    auto listening = doc == volume_outlines_present;
+    if(listening)
+        volume_outlines_listening(false);
+
+    QTextCursor cursor(doc);
+    cursor.beginEditBlock();
+    auto follower = outlines_follower_of(outline_node);
+    auto follow_block = follower? volume_outlines_title_block(doc, follower): QTextBlock();
+    if(follow_block.isValid()){
+        // 在前一节末尾分块，原有块的用户数据保留在前半部分
+        auto prev = follow_block.previous();
+        cursor.setPosition(prev.position() + prev.length() - 1);
+        cursor.insertBlock();
+        write_volume_outlines_section(cursor, outline_node, description);
+    }
+    else {
+        // 文末空块
+        cursor.movePosition(QTextCursor::End);
+        write_volume_outlines_section(cursor, outline_node, description);
+        cursor.insertBlock();
     }
+    cursor.endEditBlock();
+    // 撤销结构修补会留下无节点数据的标题块
+    doc->clearUndoRedoStacks();
 
-    if(target.type() == TnType::STORYBLOCK){
-        auto points = branchattach_hdl.getPointsViaStoryblock(target);
-        for (auto dot : points) {
-            auto foreshadownode = dot.attachedDespline();
-            msgList << "[error](foreshadow·despline)<"+foreshadownode.title()+">影响指定伏笔[故事线]，请注意修改描述！";
+    if(listening)
+        volume_outlines_listening(true);
+}
 
-            auto chapternode = dot.attachedChapter();
-            if(chapternode.isValid())
-                msgList << "[error](chapter)<"+chapternode.title()+">影响章节内容！请重写相关内容！";
-        }
+void NovelHost::patch_volume_outlines_remove(OutlinesItem *outline_node)
+{
+    auto doc = cached_volume_outlines_of(outline_node);
+    if(!doc)
+        return;
+
+    auto title_block = volume_outlines_title_block(doc, outline_node);
+    if(!title_block.isValid())
+        return;
+
+    auto listening = doc == volume_outlines_present;
+    if(listening)
+        volume_outlines_listening(false);
+
+    // 自前一节末尾删至本节（含子节点）末尾，前后仅余描述块合并，标题块数据不受影响
+    auto follower = outlines_follower_of(outline_node);
+    auto follow_block = follower? volume_outlines_title_block(doc, follower): QTextBlock();
+    auto last_block = (follow_block.isValid()? follow_block: doc->lastBlock()).previous();
+    auto prev = title_block.previous();
+
+    QTextCursor cursor(doc);
+    cursor.setPosition(prev.position() + prev.length() - 1);
+    cursor.setPosition(last_block.position() + last_block.length() - 1, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    doc->clearUndoRedoStacks();
+
+    auto &titles = volume_outlines_titles[doc];
+    QList<QStandardItem*> subtree{outline_node};
+    while (subtree.size()) {
+        auto item = subtree.takeLast();
+        titles.remove(static_cast<OutlinesItem*>(item)->uniqueID());
+        for (int row=0; row<item->rowCount(); ++row)
+            subtree << item->child(row);
     }
 
-    if(target.type() == TnType::VOLUME){
-        auto despline_count = target.childCount(TnType::DESPLINE);
-        for (int var = 0; var < despline_count; ++var) {
-            _check_remove_effect(target.childAt(TnType::DESPLINE,var), msgList);
-        }
+    if(listening)
+        volume_outlines_listening(true);
+}
 
-        auto storyblock_count = target.childCount(TnType::STORYBLOCK);
-        for (int var = 0; var < storyblock_count; ++var) {
-            _check_remove_effect(target.childAt(TnType::STORYBLOCK, var), msgList);
-        }
+// msgList : [type](target)<keys-to-target>msg-body
+void NovelHost::_check_remove_effect(const DBAccess::StoryTreeNode &target, QList<QString> &msgList) const
+{
+    if(target.type() == TnType::KEYPOINT)
+        return;
 
-        auto chapter_count = target.childCount(TnType::CHAPTER);
-        for (int var = 0; var < chapter_count; ++var) {
-            _check_remove_effect(target.childAt(TnType::CHAPTER, var), msgList);
+    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
+    QList<QPair<int, QString>> desplines;
+    QList<DBAccess::StoryTreeController::PointImpact> points;
+    storytree_hdl.removeImpactOf(target, desplines, points);
+
+    // 驻点按支线分组，逐支线输出时无需重复遍历
+    QHash<int, QList<int>> points_of_despline;
+    for (int index=0; index<points.size(); ++index)
+        points_of_despline[points.at(index).despline_id] << index;
+
+    for (auto despline : desplines) {
+        msgList << "[warring](foreshadow·despline)<"+despline.second+">指定伏笔[故事线]将被删除，请注意！";
+
+        for (auto point_index : points_of_despline.value(despline.first)) {
+            auto &dot = points.at(point_index);
+            if(dot.storyblock_id >= 0)
+                msgList << "[error](keystory·storyblock)<"+dot.storyblock_title+">影响关键剧情！请重写相关内容！";
+            if(dot.chapter_id >= 0)
+                msgList << "[error](chapter)<"+dot.chapter_title+">影响章节内容！请重写相关内容！";
         }
     }
 
-    if(target.type() == TnType::CHAPTER){
-        auto points = branchattach_hdl.getPointsViaChapter(target);
-        for (auto dot : points) {
-            auto foreshadownode = dot.attachedDespline();
-            msgList << "[error](foreshadow·despline)<"+foreshadownode.title()+">影响指定伏笔[故事线]，请注意修改描述！";
-            auto storyblknode = dot.attachedStoryblock();
-            if(storyblknode.isValid())
-                msgList << "[error](keystory·storyblock)<"+storyblknode.title()+">影响剧情内容！请注意相关内容！";
-        }
+    for (auto dot : points) {
+        if(!dot.storyblock_removed)
+            continue;
+        msgList << "[error](foreshadow·despline)<"+dot.despline_title+">影响指定伏笔[故事线]，请注意修改描述！";
+        if(dot.chapter_id >= 0)
+            msgList << "[error](chapter)<"+dot.chapter_title+">影响章节内容！请重写相关内容！";
+    }
 
+    for (auto dot : points) {
+        if(!dot.chapter_removed)
+            continue;
+        msgList << "[error](foreshadow·despline)<"+dot.despline_title+">影响指定伏笔[故事线]，请注意修改描述！";
+        if(dot.storyblock_id >= 0)
+            msgList << "[error](keystory·storyblock)<"+dot.storyblock_title+">影响剧情内容！请注意相关内容！";
     }
 }
 
@@ -636,10 +905,8 @@ QTextDocument* NovelHost::load_chapter_text_content(QStandardItem *item)
     if(!parent) // 卷宗节点不可加载
         return nullptr;
 
-    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     // load text-content
-    auto volume_symbo = storytree_hdl.novelNode().childAt(TnType::VOLUME, parent->row());
-    auto chapter_symbo = volume_symbo.childAt(TnType::CHAPTER, item->row());
+    auto chapter_symbo = _locate_chapters_handle_via(item);
     QString content = desp_ins->chapterText(chapter_symbo);
 
     // 载入内存实例
@@ -666,8 +933,26 @@ QTextDocument* NovelHost::load_chapter_text_content(QStandardItem *item)
     // 纳入管理机制
     auto renderer = new WordsRender(doc, *this);
     all_documents.insert(static_cast<ChaptersItem*>(item), qMakePair(doc, renderer));
-    connect(doc, &QTextDocument::contentsChanged, static_cast<ChaptersItem*>(item),  &ChaptersItem::calcWordsCount);
+    auto chapter_id = static_cast<ChaptersItem*>(item)->uniqueID();
+    connect(doc, &QTextDocument::contentsChanged,   this,   [this, chapter_id]{
+        auto chapter_item = chapters_items_index.value(chapter_id);
+        if(chapter_item)
+            chapter_item->calcWordsCount();
+    });
     connect(doc, &QTextDocument::cursorPositionChanged, this,   &NovelHost::acceptEditingTextblock);
+    connect(doc, &QTextDocument::contentsChanged,   this,   [this, doc]{
+        if(!mentions_documents.contains(doc))
+            return;
+        mentions_dirty_documents.insert(doc);
+        mentions_reindex_timer->start();
+    });
+    // 仅重新索引本章节
+    mentions_documents.insert(doc, chapter_id);
+    _reindex_chapter_mentions(chapter_id, doc->toPlainText());
+    mentions_pending_full.remove(chapter_id);
+    mentions_pending_keys.remove(chapter_id);
+    // 字数改由编辑中文本计算
+    static_cast<ChaptersItem*>(item)->calcWordsCount();
 
     return doc;
 }
@@ -747,7 +1032,10 @@ void NovelHost::_load_all_keywords_types_only_once()
             table_row.first()->appendRow(field_row);
         }
 
-        auto keywords_model = new QStandardItemModel(this);
+        auto keywords_model = new KeywordsTableModel(desp_ins, table, this);
+        keywords_model->setMentionsCounter([this](const QString &tableName, int uniqueID){
+            return keywordMentionsCount(tableName, uniqueID);
+        });
         keywords_manager_group.append(qMakePair(table, keywords_model));
 
         table = table.nextSibling();
@@ -770,7 +1058,10 @@ QAbstractItemModel *NovelHost::appendKeywordsModelToTheList(const QString &name)
 {
     DBAccess::KeywordController keywords_proc(*desp_ins);
     auto newtable = keywords_proc.newTable(name);
-    auto model = new QStandardItemModel(this);
+    auto model = new KeywordsTableModel(desp_ins, newtable, this);
+    model->setMentionsCounter([this](const QString &tableName, int uniqueID){
+        return keywordMentionsCount(tableName, uniqueID);
+    });
     keywords_manager_group.append(qMakePair(newtable, model));
 
     QList<QStandardItem*> row;
@@ -961,7 +1252,15 @@ void NovelHost::adjustKeywordsFieldsViaTheList(const QModelIndex &mindex, const
                     }
                 }
             }
-            keywords_proc.tablefieldsAdjust(pair.first, convert_peer);
+            appendActiveTask("关键字表结构调整");
+            try {
+                keywords_proc.tablefieldsAdjust(pair.first, convert_peer);
+            } catch (WsException *e) {
+                finishActiveTask("关键字表结构调整", "关键字表结构调整失败");
+                throw e;
+            }
+            pair.second->refreshSchema();
+            finishActiveTask("关键字表结构调整", "关键字表结构调整完成");
             break;
         }
     }
@@ -999,19 +1298,72 @@ void NovelHost::renameKeywordsTypenameViaTheList(const QModelIndex &mindex, cons
         if(pair.first.registID() == table_id){
             keywords_proc.resetNameOf(pair.first, newName);
             keywords_types_configmodel->setData(mindex, newName);
+            pair.second->refreshSchema();
             break;
         }
     }
 }
 
 void NovelHost::queryKeywordsViaTheList(const QModelIndex &mindex, const QString &itemName) const
+{
+    auto table_id = extract_tableid_from_the_typelist_model(mindex);
+
+    for (auto pair : keywords_manager_group) {
+        if(pair.first.registID() == table_id){
+            pair.second->resetQuery(itemName);
+            break;
+        }
+    }
+}
+
+static QChar _separator_via_suffix(const QString &filePath)
+{
+    return QFileInfo(filePath).suffix().toLower() == "tsv" ? QChar('\t') : QChar(',');
+}
+
+int NovelHost::importKeywordsViaTheList(const QModelIndex &mindex, const QString &filePath, QStringList &rejected)
+{
+    auto table_id = extract_tableid_from_the_typelist_model(mindex);
+    DBAccess::KeywordController keywords_proc(*desp_ins);
+
+    for (auto pair : keywords_manager_group) {
+        if(pair.first.registID() == table_id){
+            QFile file(filePath);
+            if(!file.open(QIODevice::ReadOnly|QIODevice::Text))
+                throw new WsException("指定文件无法打开："+filePath);
+            QTextStream in(&file);
+            in.setCodec("UTF-8");
+
+            appendActiveTask("关键字导入");
+            int count = 0;
+            try {
+                count = keywords_proc.importKeywords(pair.first, in, _separator_via_suffix(filePath), rejected);
+            } catch (WsException *e) {
+                finishActiveTask("关键字导入", "关键字导入失败");
+                throw e;
+            }
+            finishActiveTask("关键字导入", QString("关键字导入完成：%1条，未识别%2条").arg(count).arg(rejected.size()));
+            return count;
+        }
+    }
+    return 0;
+}
+
+void NovelHost::exportKeywordsViaTheList(const QModelIndex &mindex, const QString &filePath) const
 {
     auto table_id = extract_tableid_from_the_typelist_model(mindex);
     DBAccess::KeywordController keywords_proc(*desp_ins);
 
     for (auto pair : keywords_manager_group) {
         if(pair.first.registID() == table_id){
-            keywords_proc.queryKeywordsLike(pair.second, itemName, pair.first);
+            QFile file(filePath);
+            if(!file.open(QIODevice::WriteOnly|QIODevice::Text))
+                throw new WsException("指定文件无法写入："+filePath);
+            QTextStream out(&file);
+            out.setCodec("UTF-8");
+            out.setGenerateByteOrderMark(true);
+
+            keywords_proc.exportKeywords(pair.first, out, _separator_via_suffix(filePath));
             break;
         }
     }
@@ -1029,6 +1381,12 @@ QList<QPair<int, QString> > NovelHost::avaliableItemsForIndex(const QModelIndex
     return keywords_proc.avaliableItemsForIndex(index);
 }
 
+QList<QPair<int, QString>> NovelHost::searchItemsForIndex(const QModelIndex &index, const QString &fragment, int limit) const
+{
+    DBAccess::KeywordController keywords_proc(*desp_ins);
+    return keywords_proc.searchItemsForIndex(index, fragment, limit);
+}
+
 QModelIndex NovelHost::get_table_presentindex_via_typelist_model(const QModelIndex &mindex) const
 {
     if(!mindex.isValid() && mindex.model()!=keywords_types_configmodel)
@@ -1064,24 +1422,28 @@ void NovelHost::insertChapter(const QModelIndex &pIndex, const QString &name, co
 
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     auto volume_item = chapters_navigate_treemodel->item(pIndex.row());
-    auto struct_volume = storytree_hdl.novelNode().childAt(TnType::VOLUME, volume_item->row());
+    auto struct_volume = _locate_chapters_handle_via(volume_item);
     auto count = struct_volume.childCount(TnType::CHAPTER);
 
     QList<QStandardItem*> row;
     if(index < 0 || index >= count){
         auto newnode = storytree_hdl.insertChildNodeBefore(struct_volume, TnType::CHAPTER, count, name, description);
-        desp_ins->resetChapterText(newnode, "章节内容为空");
-        row << new ChaptersItem(*this, newnode);
-        row << new QStandardItem("-");
+        store_chapter_text(newnode, "章节内容为空");
+        _enqueue_chapter_mentions(newnode.uniqueID());
+        row << new_chapters_item(newnode);
+        row << new WordsCountItem(*this);
         volume_item->appendRow(row);
     }
     else {
         auto newnode = storytree_hdl.insertChildNodeBefore(struct_volume, TnType::CHAPTER, index, name, description);
-        desp_ins->resetChapterText(newnode, "章节内容为空");
-        row << new ChaptersItem(*this, newnode);
-        row << new QStandardItem("-");
+        store_chapter_text(newnode, "章节内容为空");
+        _enqueue_chapter_mentions(newnode.uniqueID());
+        row << new_chapters_item(newnode);
+        row << new WordsCountItem(*this);
         volume_item->insertRow(index, row);
     }
+    static_cast<WordsCountItem*>(chapters_navigate_treemodel->item(volume_item->row(), 1))->invalidate();
+    despline_coverage.clear();
 }
 
 void NovelHost::insertAttachpoint(int desplineID, const QString &title, const QString &desp, int index)
@@ -1093,10 +1455,19 @@ void NovelHost::insertAttachpoint(int desplineID, const QString &title, const QS
         throw new WsException("指定despline节点id非法");
 
     auto points = branchattach_hdl.getPointsViaDespline(despline);
-    if(index > -1 && index < points.size())
-        branchattach_hdl.insertPointBefore(despline, index, title, desp);
-    else
-        branchattach_hdl.insertPointBefore(despline, points.size(), title, desp);
+    if(index < 0 || index >= points.size())
+        index = points.size();
+    auto point = branchattach_hdl.insertPointBefore(despline, index, title, desp);
+
+    auto despline_item = despline_summary_items.value(desplineID);
+    if(!despline_item)
+        return;
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
+    despline_item->insertRow(index, attachpoint_summary_row(point));
+    reset_despline_summary_state(despline_item);
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
 }
 
 void NovelHost::removeAttachpoint(int attachpointID)
@@ -1106,6 +1477,17 @@ void NovelHost::removeAttachpoint(int attachpointID)
     if(point.attachedChapter().isValid() || point.attachedStoryblock().isValid())
         throw new WsException("目标驻点非悬空驻点，不可删除！");
     branchattach_hdl.removePoint(point);
+
+    auto item = attachpoint_summary_items.take(attachpointID);
+    if(!item)
+        return;
+    auto despline_item = item->parent();
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
+    despline_item->removeRow(item->row());
+    reset_despline_summary_state(despline_item);
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
 }
 
 void NovelHost::attachPointMoveup(const QModelIndex &desplineIndex)
@@ -1125,8 +1507,13 @@ void NovelHost::attachPointMoveup(const QModelIndex &desplineIndex)
 
     auto pnode = source_model->itemFromIndex(source_mindex.parent());
     auto row_num = source_mindex.row();
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
     auto row = pnode->takeRow(row_num);
     pnode->insertRow(row_num-1, row);
+    reset_despline_summary_state(pnode);
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
 }
 
 void NovelHost::attachPointMovedown(const QModelIndex &desplineIndex)
@@ -1146,8 +1533,13 @@ void NovelHost::attachPointMovedown(const QModelIndex &desplineIndex)
 
     auto pnode = source_model->itemFromIndex(source_mindex.parent());
     auto row_num = source_mindex.row();
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
     auto row = pnode->takeRow(row_num);
     pnode->insertRow(row_num+1, row);
+    reset_despline_summary_state(pnode);
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
 }
 
 
@@ -1156,38 +1548,153 @@ void NovelHost::removeChaptersNode(const QModelIndex &chaptersNode)
     if(!chaptersNode.isValid() || chaptersNode.model() != chapters_navigate_treemodel)
         throw new WsException("chaptersNodeIndex无效");
 
-    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     auto chapter = chapters_navigate_treemodel->itemFromIndex(chaptersNode);
     int row = chapter->row();
     // 卷宗节点管理同步
     if(indexDepth(chaptersNode)==1){
-        auto struct_volume = storytree_hdl.novelNode().childAt(TnType::VOLUME, row);
-
-        outline_navigate_treemodel->removeRow(row);
-        chapters_navigate_treemodel->removeRow(row);
-
-        storytree_hdl.removeNode(struct_volume);
+        remove_volume_node(row);
     }
     // 章节节点
     else {
+        DBAccess::StoryTreeController storytree_hdl(*desp_ins);
         auto volume = chapter->parent();
-        auto struct_volume = storytree_hdl.novelNode().childAt(TnType::VOLUME, volume->row());
-        auto struct_chapter = struct_volume.childAt(TnType::CHAPTER, row);
-        volume->removeRow(row);
+        auto struct_chapter = _locate_chapters_handle_via(chapter);
+        description_write_behind->flush();
 
+        QList<QPair<int, QString>> desplines;
+        QList<DBAccess::StoryTreeController::PointImpact> points;
+        storytree_hdl.removeImpactOf(struct_chapter, desplines, points);
         storytree_hdl.removeNode(struct_chapter);
+
+        if(current_chapter_node == struct_chapter)
+            current_chapter_node = DBAccess::StoryTreeNode();
+        release_chapter_documents(QList<QStandardItem*>() << chapter);
+        forget_navigate_items(chapter);
+        volume->removeRow(row);
+        static_cast<WordsCountItem*>(chapters_navigate_treemodel->item(volume->row(), 1))->invalidate();
+        drop_removed_desplines_summary(desplines, points, -1);
+        _unindex_chapters_mentions(QList<int>() << struct_chapter.uniqueID());
     }
 }
 
-void NovelHost::set_current_chapter_content(const QModelIndex &chaptersNode, const DBAccess::StoryTreeNode &node)
+void NovelHost::remove_volume_node(int volumeIndex)
 {
-    if(current_chapter_node == node)
-        return;
-    else
-        current_chapter_node = node;
+    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
+    auto volume_item = chapters_navigate_treemodel->item(volumeIndex);
+    auto struct_volume = _locate_chapters_handle_via(volume_item);
+    description_write_behind->flush();
+
+    QList<QPair<int, QString>> desplines;
+    QList<DBAccess::StoryTreeController::PointImpact> points;
+    storytree_hdl.removeImpactOf(struct_volume, desplines, points);
+    auto current_removed = current_chapter_node.isValid() && current_chapter_node.parent() == struct_volume;
+    storytree_hdl.removeNode(struct_volume);
+
+    if(current_removed)
+        current_chapter_node = DBAccess::StoryTreeNode();
+    if(current_volume_node == struct_volume)
+        current_volume_node = DBAccess::StoryTreeNode();
+
+    // 卷下全部章节文档一并释放，两棵树各移除一行
+    QList<QStandardItem*> chapter_items;
+    QList<int> chapter_ids;
+    for (int chp_index=0; chp_index<volume_item->rowCount(); ++chp_index){
+        chapter_items << volume_item->child(chp_index);
+        chapter_ids << static_cast<ChaptersItem*>(volume_item->child(chp_index))->uniqueID();
+    }
+    release_chapter_documents(chapter_items);
+    evict_volume_outlines(struct_volume.uniqueID());
+    forget_navigate_items(volume_item);
+    forget_navigate_items(outline_navigate_treemodel->item(volumeIndex));
+
+    outline_navigate_treemodel->removeRow(volumeIndex);
+    chapters_navigate_treemodel->removeRow(volumeIndex);
+
+    drop_removed_desplines_summary(desplines, points, volumeIndex);
+    _unindex_chapters_mentions(chapter_ids);
+}
+
+void NovelHost::release_chapter_documents(const QList<QStandardItem *> &chapterItems)
+{
+    QList<QTextDocument*> docs;
+    for (auto item : chapterItems) {
+        auto chapter = static_cast<ChaptersItem*>(item);
+        if(!all_documents.contains(chapter))
+            continue;
 
-    disconnect(chapter_outlines_present,    &QTextDocument::contentsChanged,this,   &NovelHost::listen_chapter_outlines_description_change);
-    chapter_outlines_present->clear();
+        auto pack = all_documents.take(chapter);
+        mentions_documents.remove(pack.first);
+        mentions_dirty_documents.remove(pack.first);
+        emit documentAboutToBoClosed(pack.first);
+        docs << pack.first;
+    }
+
+    // 渲染器以文档为父对象，随文档一并析构
+    for (auto doc : docs)
+        doc->deleteLater();
+}
+
+void NovelHost::drop_removed_desplines_summary(const QList<QPair<int, QString>> &desplines,
+                                               const QList<DBAccess::StoryTreeController::PointImpact> &points, int removedVolume)
+{
+    // 章节序列可能变化，覆盖统计待下次查询时重建
+    despline_coverage.clear();
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
+
+    // 受影响驻点均已随级联删除
+    QSet<QStandardItem*> touched_desplines;
+    for (auto dot : points) {
+        auto item = attachpoint_summary_items.take(dot.point_id);
+        if(!item || dot.despline_removed)
+            continue;
+
+        auto despline_item = item->parent();
+        despline_item->removeRow(item->row());
+        touched_desplines.insert(despline_item);
+    }
+
+    for (auto despline : desplines) {
+        despline_summaries.remove(despline.first);
+        despline_coverage.removeDespline(despline.first);
+        auto item = despline_summary_items.take(despline.first);
+        if(item)
+            desplines_fuse_source_model->removeRow(item->row());
+    }
+
+    // 后续卷宗序号前移
+    if(removedVolume >= 0){
+        for (auto item : despline_summary_items) {
+            auto volume_index = item->data(Qt::UserRole+2).toInt();
+            if(volume_index > removedVolume)
+                item->setData(volume_index-1, Qt::UserRole+2);
+            touched_desplines.insert(item);
+        }
+        for (auto item : attachpoint_summary_items) {
+            auto volume_mark = item->data(Qt::UserRole+2);
+            if(volume_mark.isValid() && volume_mark.toInt() > removedVolume)
+                item->setData(volume_mark.toInt()-1, Qt::UserRole+2);
+        }
+    }
+
+    for (auto item : touched_desplines)
+        reset_despline_summary_state(item);
+
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
+}
+
+void NovelHost::set_current_chapter_content(const QModelIndex &chaptersNode, const DBAccess::StoryTreeNode &node)
+{
+    if(current_chapter_node == node)
+        return;
+    else
+        current_chapter_node = node;
+
+    description_write_behind->flush();
+
+    disconnect(chapter_outlines_present,    &QTextDocument::contentsChanged,this,   &NovelHost::listen_chapter_outlines_description_change);
+    chapter_outlines_present->clear();
 
     QTextFrameFormat fformat;
     config_host.textFrameFormat(fformat);
@@ -1224,17 +1731,7 @@ void NovelHost::setCurrentChaptersNode(const QModelIndex &chaptersNode)
     if(!chaptersNode.isValid() || chaptersNode.model() != chapters_navigate_treemodel)
         throw new WsException("传入的chaptersindex无效");
 
-    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
-    DBAccess::StoryTreeNode node;
-    switch (indexDepth(chaptersNode)) {
-        case 1: // 卷宗
-            node = storytree_hdl.novelNode().childAt(TnType::VOLUME, chaptersNode.row());
-            break;
-        case 2: // 章节
-            auto struct_volume = storytree_hdl.novelNode().childAt(TnType::VOLUME, chaptersNode.parent().row());
-            node = struct_volume.childAt(TnType::CHAPTER, chaptersNode.row());
-            break;
-    }
+    auto node = _locate_chapters_handle_via(chapters_navigate_treemodel->itemFromIndex(chaptersNode));
 
     set_current_volume_outlines(node);
 
@@ -1254,6 +1751,17 @@ void NovelHost::setCurrentChaptersNode(const QModelIndex &chaptersNode)
 
 void NovelHost::refreshWordsCount()
 {
+    for (auto chapter : chapters_items_index) {
+        if(chapter->nodeType() != TnType::CHAPTER || all_documents.contains(chapter)
+                || chapter_words_stored.contains(chapter->uniqueID()))
+            continue;
+
+        auto struct_chapter = _locate_chapters_handle_via(chapter);
+        auto words = calcValidWordsCount(desp_ins->chapterText(struct_chapter));
+        desp_ins->resetChapterWordsCount(struct_chapter, words);
+        chapter_words_stored.insert(chapter->uniqueID(), words);
+    }
+
     for (int num=0; num < chapters_navigate_treemodel->rowCount(); ++num) {
         auto volume_title_node = chapters_navigate_treemodel->item(num);
         static_cast<ChaptersItem*>(volume_title_node)->calcWordsCount();
@@ -1265,25 +1773,13 @@ void NovelHost::sumDesplinesUntilVolume(const QModelIndex &node, QList<QPair<QSt
     if(!node.isValid())
         throw new WsException("输入index无效");
 
-    QModelIndex temp_node = node;
-    QList<QModelIndex> stack;
-    while (temp_node.isValid()) {
-        stack.insert(0, temp_node);
-        temp_node = temp_node.parent();
-    }
-    auto volume_index = stack[0];
+    QModelIndex volume_index = node;
+    while (volume_index.parent().isValid())
+        volume_index = volume_index.parent();
 
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
-    DBAccess::StoryTreeNode struct_volume;
-    for (auto index=0; index <= volume_index.row(); ++index) {
-        struct_volume = storytree_hdl.novelNode().childAt(TnType::VOLUME, index);
-        auto despline_count = struct_volume.childCount(TnType::DESPLINE);
-
-        for (int var = 0; var < despline_count; ++var) {
-            auto despline_node = struct_volume.childAt(TnType::DESPLINE, var);
-            desplines << qMakePair(despline_node.title(), despline_node.uniqueID());
-        }
-    }
+    auto struct_volume = _locate_chapters_handle_via(chapters_navigate_treemodel->item(volume_index.row()));
+    desplines << storytree_hdl.desplinesUntil(struct_volume);
 }
 
 void NovelHost::sumPointWithChapterSuspend(int desplineID, QList<QPair<QString, int> > &suspendPoints) const
@@ -1294,12 +1790,7 @@ void NovelHost::sumPointWithChapterSuspend(int desplineID, QList<QPair<QString,
     if(!despline.isValid() || despline.type() != TnType::DESPLINE)
         throw new WsException("指定输入支线ID无效");
 
-    auto points = branchattach_hdl.getPointsViaDespline(despline);
-    for (auto point : points) {
-        if(point.attachedChapter().isValid())
-            continue;
-        suspendPoints << qMakePair(point.title(), point.uniqueID());
-    }
+    suspendPoints << branchattach_hdl.pointsSummaryOf(despline, TnType::CHAPTER, DBAccess::StoryTreeNode());
 }
 
 void NovelHost::sumPointWithChapterAttached(const QModelIndex &chapterIndex, int desplineID, QList<QPair<QString, int> > &suspendPoints) const
@@ -1309,24 +1800,15 @@ void NovelHost::sumPointWithChapterAttached(const QModelIndex &chapterIndex, int
     if(indexDepth(chapterIndex)!=2)
         throw new WsException("指定index类型错误");
 
-
-
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     auto despline = storytree_hdl.getNodeViaID(desplineID);
     if(!despline.isValid() || despline.type() != TnType::DESPLINE)
         throw new WsException("指定输入支线ID无效");
 
-    auto struct_chapter = storytree_hdl.novelNode().childAt(TnType::VOLUME, chapterIndex.parent().row())
-                          .childAt(TnType::CHAPTER, chapterIndex.row());
-
-
+    auto struct_chapter = _locate_chapters_handle_via(chapters_navigate_treemodel->itemFromIndex(chapterIndex));
 
     DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
-    auto points = branchattach_hdl.getPointsViaDespline(despline);
-    for (auto point : points) {
-        if(point.attachedChapter()==struct_chapter)
-            suspendPoints << qMakePair(point.title(), point.uniqueID());
-    }
+    suspendPoints << branchattach_hdl.pointsSummaryOf(despline, TnType::CHAPTER, struct_chapter);
 }
 
 void NovelHost::chapterAttachSet(const QModelIndex &chapterIndex, int pointID)
@@ -1336,13 +1818,12 @@ void NovelHost::chapterAttachSet(const QModelIndex &chapterIndex, int pointID)
     if(indexDepth(chapterIndex)!=2)
         throw new WsException("指定index类型错误");
 
-    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
-    auto chapter = storytree_hdl.novelNode().childAt(TnType::VOLUME, chapterIndex.parent().row())
-                   .childAt(TnType::CHAPTER, chapterIndex.row());
+    auto chapter = _locate_chapters_handle_via(chapters_navigate_treemodel->itemFromIndex(chapterIndex));
     auto point = branchattach_hdl.getPointViaID(pointID);
 
     branchattach_hdl.resetChapterOf(point, chapter);
+    reset_attachpoint_summary(point);
 }
 
 void NovelHost::chapterAttachClear(int pointID)
@@ -1350,6 +1831,7 @@ void NovelHost::chapterAttachClear(int pointID)
     DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
     auto point = branchattach_hdl.getPointViaID(pointID);
     branchattach_hdl.resetChapterOf(point, DBAccess::StoryTreeNode());
+    reset_attachpoint_summary(point);
 }
 
 void NovelHost::sumPointWithStoryblcokSuspend(int desplineID, QList<QPair<QString, int> > &suspendPoints) const
@@ -1360,12 +1842,7 @@ void NovelHost::sumPointWithStoryblcokSuspend(int desplineID, QList<QPair<QStrin
     if(!despline.isValid() || despline.type() != TnType::DESPLINE)
         throw new WsException("指定输入支线ID无效");
 
-    auto points = branchattach_hdl.getPointsViaDespline(despline);
-    for (auto point : points) {
-        if(point.attachedStoryblock().isValid())
-            continue;
-        suspendPoints << qMakePair(point.title(), point.uniqueID());
-    }
+    suspendPoints << branchattach_hdl.pointsSummaryOf(despline, TnType::STORYBLOCK, DBAccess::StoryTreeNode());
 }
 
 void NovelHost::sumPointWithStoryblockAttached(const QModelIndex &outlinesIndex, int desplineID, QList<QPair<QString, int> > &suspendPoints) const
@@ -1379,15 +1856,10 @@ void NovelHost::sumPointWithStoryblockAttached(const QModelIndex &outlinesIndex,
     auto despline = storytree_hdl.getNodeViaID(desplineID);
     if(!despline.isValid() || despline.type() != TnType::DESPLINE)
         throw new WsException("指定输入支线ID无效");
-    auto storyblock = storytree_hdl.novelNode().childAt(TnType::VOLUME, outlinesIndex.parent().row())
-                      .childAt(TnType::STORYBLOCK, outlinesIndex.row());
+    auto storyblock = _locate_outline_handle_via(outline_navigate_treemodel->itemFromIndex(outlinesIndex));
 
     DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
-    auto points = branchattach_hdl.getPointsViaDespline(despline);
-    for (auto point : points) {
-        if(point.attachedStoryblock()==storyblock)
-            suspendPoints << qMakePair(point.title(), point.uniqueID());
-    }
+    suspendPoints << branchattach_hdl.pointsSummaryOf(despline, TnType::STORYBLOCK, storyblock);
 }
 
 void NovelHost::storyblockAttachSet(const QModelIndex &outlinesIndex, int pointID)
@@ -1397,13 +1869,12 @@ void NovelHost::storyblockAttachSet(const QModelIndex &outlinesIndex, int pointI
     if(indexDepth(outlinesIndex)!=2)
         throw new WsException("指定index类型错误");
 
-    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
-    auto storyblock = storytree_hdl.novelNode().childAt(TnType::VOLUME, outlinesIndex.parent().row())
-                      .childAt(TnType::STORYBLOCK, outlinesIndex.row());
+    auto storyblock = _locate_outline_handle_via(outline_navigate_treemodel->itemFromIndex(outlinesIndex));
     auto point = branchattach_hdl.getPointViaID(pointID);
 
     branchattach_hdl.resetStoryblockOf(point, storyblock);
+    reset_attachpoint_summary(point);
 }
 
 void NovelHost::storyblockAttachClear(int pointID)
@@ -1411,6 +1882,7 @@ void NovelHost::storyblockAttachClear(int pointID)
     DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
     auto point = branchattach_hdl.getPointViaID(pointID);
     branchattach_hdl.resetStoryblockOf(point, DBAccess::StoryTreeNode());
+    reset_attachpoint_summary(point);
 }
 
 
@@ -1456,28 +1928,335 @@ void NovelHost::searchText(const QString &text)
     }
 }
 
+int NovelHost::keywordMentionsCount(const QString &tableName, int uniqueID) const
+{
+    int count = 0;
+    for (auto &list : keyword_mentions.value(qMakePair(tableName, uniqueID)))
+        count += list.size();
+    return count;
+}
+
+void NovelHost::listKeywordMentions(const QString &tableName, int uniqueID)
+{
+    _flush_dirty_mentions();
+    find_results_model->clear();
+    find_results_model->setHorizontalHeaderLabels(QStringList() << "提及文本" << "卷宗节点" << "章节节点");
+
+    auto mentions = keyword_mentions.value(qMakePair(tableName, uniqueID));
+    // 按章卷顺序输出
+    for (int vm_index=0; vm_index<chapters_navigate_treemodel->rowCount(); ++vm_index) {
+        auto chapters_volume_node = chapters_navigate_treemodel->item(vm_index);
+
+        for (int chapters_chp_index=0; chapters_chp_index<chapters_volume_node->rowCount(); ++chapters_chp_index) {
+            auto chapters_chp_node = static_cast<ChaptersItem*>(chapters_volume_node->child(chapters_chp_index));
+            auto chapter_id = chapters_chp_node->uniqueID();
+            if(!mentions.contains(chapter_id))
+                continue;
+
+            QString content = chapterActiveText(chapters_chp_node->index());
+            for (auto hit : mentions.value(chapter_id)) {
+                auto pos = hit.first;
+                auto text_result = content.mid(pos, 20).replace(QRegExp("\\s"), "");
+                QList<QStandardItem*> row;
+                QStandardItem *item;
+                if(pos == 0)
+                    item = new QStandardItem(text_result.length()<20?text_result+"……":text_result);
+                else
+                    item = new QStandardItem("……"+(text_result.length()<20?text_result+"……":text_result));
+
+                item->setData(chapters_chp_node->index(), Qt::UserRole+1);
+                item->setData(pos, Qt::UserRole + 2);
+                item->setData(hit.second, Qt::UserRole + 3);
+                row << item;
+
+                row << new QStandardItem(chapters_volume_node->text());
+                row << new QStandardItem(chapters_chp_node->text());
+                find_results_model->appendRow(row);
+
+                for (auto item : row) item->setEditable(false);
+            }
+        }
+    }
+}
+
+void NovelHost::_enqueue_chapter_mentions(int chapterID, const QSet<QPair<QString, int>> &keys)
+{
+    if(mentions_pending_full.contains(chapterID))
+        return;
+    if(!mentions_pending_keys.contains(chapterID))
+        mentions_queue << chapterID;
+
+    if(keys.isEmpty()){
+        mentions_pending_keys.remove(chapterID);
+        mentions_pending_full.insert(chapterID);
+    }
+    else {
+        mentions_pending_keys[chapterID].unite(keys);
+    }
+    mentions_slice_timer->start();
+}
+
+void NovelHost::_process_mentions_slice()
+{
+    // 每片限时处理，已加载章节取编辑中文本，其余取存储文本
+    const int slice_msecs = 12;
+    QElapsedTimer clock;
+    clock.start();
+
+    while (mentions_queue.size() && clock.elapsed() < slice_msecs) {
+        auto chapter_id = mentions_queue.takeFirst();
+        auto full = mentions_pending_full.remove(chapter_id);
+        auto keys = mentions_pending_keys.take(chapter_id);
+        auto chapter = chapters_items_index.value(chapter_id);
+        if(!chapter || (!full && keys.isEmpty()))
+            continue;
+
+        QString content;
+        if(all_documents.contains(chapter))
+            content = all_documents.value(chapter).first->toPlainText();
+        else
+            WsExcept(content = desp_ins->chapterText(_locate_chapters_handle_via(chapter)));
+
+        if(full)
+            _reindex_chapter_mentions(chapter_id, content);
+        else
+            _scan_chapter_mentions(chapter_id, content, keys);
+    }
+
+    if(mentions_queue.size())
+        mentions_slice_timer->start();
+    else
+        _notify_mentions_updated();
+}
+
+void NovelHost::_sync_mentions_keywords()
+{
+    auto registed = config_host.registeredKeywords();
+    QSet<QPair<QString, int>> changed;
+    for (auto it=mentions_keywords.constBegin(); it!=mentions_keywords.constEnd(); ++it) {
+        if(registed.value(it.key()) != it.value())
+            changed << it.key();
+    }
+    for (auto it=registed.constBegin(); it!=registed.constEnd(); ++it) {
+        if(!mentions_keywords.contains(it.key()))
+            changed << it.key();
+    }
+    mentions_keywords = registed;
+    if(changed.isEmpty())
+        return;
+
+    // 变更关键字的旧提及即刻撤除，新词形逐章补扫
+    for (auto key : changed) {
+        for (auto chapter_id : keyword_mentions.take(key).keys()) {
+            auto it = chapter_mentions.find(chapter_id);
+            if(it == chapter_mentions.end())
+                continue;
+            it->remove(key);
+            if(it->isEmpty())
+                chapter_mentions.erase(it);
+        }
+    }
+    QSet<QPair<QString, int>> rescan;
+    for (auto key : changed) {
+        if(mentions_keywords.contains(key))
+            rescan << key;
+    }
+    if(rescan.size()){
+        for (auto chapter : chapters_items_index) {
+            if(chapter->nodeType() == TnType::CHAPTER)
+                _enqueue_chapter_mentions(chapter->uniqueID(), rescan);
+        }
+    }
+    _notify_mentions_updated();
+}
+
+void NovelHost::_unindex_chapter_mentions(int chapterID)
+{
+    for (auto key : chapter_mentions.take(chapterID)) {
+        auto it = keyword_mentions.find(key);
+        if(it == keyword_mentions.end())
+            continue;
+        it->remove(chapterID);
+        if(it->isEmpty())
+            keyword_mentions.erase(it);
+    }
+}
+
+void NovelHost::_unindex_chapters_mentions(const QList<int> &chapterIDs)
+{
+    for (auto chapter_id : chapterIDs) {
+        _unindex_chapter_mentions(chapter_id);
+        mentions_queue.removeOne(chapter_id);
+        mentions_pending_full.remove(chapter_id);
+        mentions_pending_keys.remove(chapter_id);
+    }
+
+    _notify_mentions_updated();
+}
+
+void NovelHost::_reindex_chapter_mentions(int chapterID, const QString &content)
+{
+    _unindex_chapter_mentions(chapterID);
+
+    QList<std::tuple<QString, int, int, int>> hits;
+    config_host.matchKeywords(content, hits);
+    if(hits.isEmpty())
+        return;
+
+    auto &keys = chapter_mentions[chapterID];
+    for (auto hit : hits) {
+        auto key = qMakePair(std::get<0>(hit), std::get<1>(hit));
+        keyword_mentions[key][chapterID] << qMakePair(std::get<2>(hit), std::get<3>(hit));
+        keys.insert(key);
+    }
+}
+
+void NovelHost::_scan_chapter_mentions(int chapterID, const QString &content, const QSet<QPair<QString, int>> &keys)
+{
+    for (auto key : keys) {
+        auto it = keyword_mentions.find(key);
+        if(it != keyword_mentions.end()){
+            it->remove(chapterID);
+            if(it->isEmpty())
+                keyword_mentions.erase(it);
+        }
+        if(chapter_mentions.contains(chapterID))
+            chapter_mentions[chapterID].remove(key);
+
+        // 与matchKeywords一致，逐位置匹配，允许重叠
+        auto words = mentions_keywords.value(key);
+        if(words.isEmpty())
+            continue;
+        QList<QPair<int, int>> hits;
+        for (auto pos = content.indexOf(words); pos >= 0; pos = content.indexOf(words, pos + 1))
+            hits << qMakePair(pos, words.length());
+        if(hits.isEmpty())
+            continue;
+
+        keyword_mentions[key][chapterID] = hits;
+        chapter_mentions[chapterID].insert(key);
+    }
+    if(chapter_mentions.contains(chapterID) && chapter_mentions[chapterID].isEmpty())
+        chapter_mentions.remove(chapterID);
+}
+
+void NovelHost::_flush_dirty_mentions()
+{
+    mentions_reindex_timer->stop();
+    _sync_mentions_keywords();
+    if(mentions_dirty_documents.isEmpty())
+        return;
+
+    for (auto doc : mentions_dirty_documents) {
+        if(!mentions_documents.contains(doc))
+            continue;
+        auto chapter_id = mentions_documents.value(doc);
+        _reindex_chapter_mentions(chapter_id, doc->toPlainText());
+        // 全量重建已覆盖该章待处理项
+        mentions_pending_full.remove(chapter_id);
+        mentions_pending_keys.remove(chapter_id);
+    }
+    mentions_dirty_documents.clear();
+
+    _notify_mentions_updated();
+}
+
+void NovelHost::_notify_mentions_updated()
+{
+    for (auto pair : keywords_manager_group)
+        pair.second->mentionsUpdated();
+}
+
 void NovelHost::pushToQuickLook(const QTextBlock &block, const QList<QPair<QString, int> > &mixtureList_)
 {
     if(current_editing_textblock != block)
         return;
 
-    // 清洗重复项
-    auto mixtureList = mixtureList_;
-    for (auto base_index=0; base_index<mixtureList.size();++base_index) {
-        auto base = mixtureList.at(base_index);
+    // 清洗重复项，保持出现顺序
+    QList<QPair<QString, int>> mixtureList;
+    QSet<QPair<QString, int>> filter;
+    for (auto pair : mixtureList_) {
+        if(filter.contains(pair))
+            continue;
+        filter << pair;
+        mixtureList << pair;
+    }
 
-        for (auto cursor_index=base_index+1; cursor_index<mixtureList.size(); ++cursor_index) {
-            auto cursor = mixtureList.at(cursor_index);
+    if(mixtureList == quicklook_present_keys)
+        return;
 
-            if(base.first == cursor.first && base.second == cursor.second){
-                mixtureList.removeAt(cursor_index);
-                cursor_index--;
+    // 按(表名,id)比对既有根行，仅增删移动变化的行
+    NovelBase::DBAccess::KeywordController handle(*desp_ins);
+    if(!quicklook_backend_model->columnCount())
+        quicklook_backend_model->setHorizontalHeaderLabels(QStringList() << "类别"<<"数据");
+    for (int index=0; index<mixtureList.size(); ++index) {
+        auto key = mixtureList.at(index);
+
+        int exists_row = -1;
+        for (int row=index; row<quicklook_backend_model->rowCount(); ++row) {
+            auto root = quicklook_backend_model->item(row);
+            if(root->data(Qt::UserRole+1).toString() == key.first && root->data(Qt::UserRole+2).toInt() == key.second){
+                exists_row = row;
+                break;
             }
         }
+
+        if(exists_row == index)
+            continue;
+        if(exists_row > index)
+            quicklook_backend_model->insertRow(index, quicklook_backend_model->takeRow(exists_row));
+        else{
+            QSet<QPair<QString, int>> involved;
+            quicklook_backend_model->insertRow(index, handle.quickLookRowOf(key, &involved));
+            quicklook_involved[key] = involved;
+        }
+    }
+    if(quicklook_backend_model->rowCount() > mixtureList.size())
+        quicklook_backend_model->removeRows(mixtureList.size(), quicklook_backend_model->rowCount() - mixtureList.size());
+
+    for (auto it=quicklook_involved.begin(); it!=quicklook_involved.end();) {
+        if(filter.contains(it.key()))
+            ++it;
+        else
+            it = quicklook_involved.erase(it);
     }
+    quicklook_present_keys = mixtureList;
+}
+
+void NovelHost::reset_quicklook_model()
+{
+    quicklook_present_keys.clear();
+    quicklook_involved.clear();
+    quicklook_backend_model->removeRows(0, quicklook_backend_model->rowCount());
+}
 
+void NovelHost::patch_quicklook_model(const QString &tableName, int id)
+{
+    auto changed = qMakePair(tableName, id);
     NovelBase::DBAccess::KeywordController handle(*desp_ins);
-    handle.queryKeywordsViaMixtureList(mixtureList, quicklook_backend_model);
+
+    // 仅重建展开涉及该条目的行，其余行保持原样
+    for (int row=quicklook_backend_model->rowCount()-1; row>=0; --row) {
+        auto key = quicklook_present_keys.at(row);
+        if(!quicklook_involved.value(key).contains(changed))
+            continue;
+
+        QSet<QPair<QString, int>> involved;
+        QList<QStandardItem*> fresh;
+        try {
+            fresh = handle.quickLookRowOf(key, &involved);
+        } catch (WsException *) {
+            // 根条目已删除
+            quicklook_backend_model->removeRow(row);
+            quicklook_present_keys.removeAt(row);
+            quicklook_involved.remove(key);
+            continue;
+        }
+
+        quicklook_backend_model->removeRow(row);
+        quicklook_backend_model->insertRow(row, fresh);
+        quicklook_involved[key] = involved;
+    }
 }
 
 QString NovelHost::chapterActiveText(const QModelIndex &index0)
@@ -1495,10 +2274,27 @@ QString NovelHost::chapterActiveText(const QModelIndex &index0)
         return "";
 
     auto refer_node = static_cast<ChaptersItem*>(item);
-    if(!all_documents.contains(refer_node)) return 0;
+    if(!all_documents.contains(refer_node))
+        return desp_ins->chapterText(_locate_chapters_handle_via(refer_node));
     return all_documents.value(refer_node).first->toPlainText();
 }
 
+int NovelHost::chapterWordsCount(const QModelIndex &chapterIndex)
+{
+    auto item = static_cast<ChaptersItem*>(chapters_navigate_treemodel->itemFromIndex(chapterIndex.sibling(chapterIndex.row(), 0)));
+    if(all_documents.contains(item))
+        return calcValidWordsCount(all_documents.value(item).first->toPlainText());
+    return chapter_words_stored.value(item->uniqueID(), -1);
+}
+
+void NovelHost::store_chapter_text(const DBAccess::StoryTreeNode &chapter, const QString &content)
+{
+    auto words = calcValidWordsCount(content);
+    desp_ins->resetChapterText(chapter, content);
+    desp_ins->resetChapterWordsCount(chapter, words);
+    chapter_words_stored.insert(chapter.uniqueID(), words);
+}
+
 int NovelHost::calcValidWordsCount(const QString &content)
 {
     QString newtext = content;
@@ -1511,9 +2307,14 @@ void NovelHost::refreshDesplinesSummary()
     desplines_fuse_source_model->clear();
     desplines_fuse_source_model->setHorizontalHeaderLabels(
                 QStringList()<<"名称"<<"索引"<<"描述"<<"所属卷"<<"所属章"<<"关联剧情");
+    despline_summary_items.clear();
+    attachpoint_summary_items.clear();
+    despline_summaries.clear();
+    despline_coverage.clear();
 
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
-    DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
     auto root = storytree_hdl.novelNode();
     auto volume_count = root.childCount(TnType::VOLUME);
     for (int volume_index = 0; volume_index < volume_count; ++volume_index) {
@@ -1522,126 +2323,327 @@ void NovelHost::refreshDesplinesSummary()
         auto despline_count = volume_one.childCount(TnType::DESPLINE);
         for (int despline_index = 0; despline_index < despline_count; ++despline_index) {
             auto despline_one = volume_one.childAt(TnType::DESPLINE, despline_index);
-            auto attach_points = branchattach_hdl.getPointsViaDespline(despline_one);
+            desplines_fuse_source_model->appendRow(despline_summary_row(despline_one, volume_one, volume_index));
+        }
+    }
+    refresh_despline_coverage();
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
+}
 
-            QList<QStandardItem*> row;
-            row << new QStandardItem(despline_one.title());                     // displayrole  ：显示文字
-            row.last()->setData(1, Qt::UserRole+1);                             // userrole+1   ：despline-mk
-            row.last()->setData(despline_one.parent().index(), Qt::UserRole+2); // userrole+2   ：起始卷宗
+QList<QStandardItem *> NovelHost::despline_summary_row(const DBAccess::StoryTreeNode &despline,
+                                                       const DBAccess::StoryTreeNode &volume, int volumeIndex)
+{
+    DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
 
-            if(!attach_points.size()){
-                row.last()->setIcon(QIcon(":/foreshadow/icon/云朵.png"));
-            }
-            else {
-                row.last()->setIcon(QIcon(":/foreshadow/icon/okpic.png"));
-
-                // append-attachpoint
-                for (auto point : attach_points) {
-                    auto chpnode = point.attachedChapter();
-
-                    QList<QStandardItem*> points_row;
-                    points_row << new QStandardItem(point.title());
-                    points_row.last()->setData(2, Qt::UserRole+1);
-                    if(!chpnode.isValid()){
-                        row.last()->setIcon(QIcon(":/foreshadow/icon/曲别针.png"));
-                        points_row.last()->setData(QVariant(), Qt::UserRole+2);
-                        points_row.last()->setData(QVariant(), Qt::UserRole+3);
-                    }
-                    else {
-                        points_row.last()->setData(chpnode.parent().index(), Qt::UserRole+2);
-                        points_row.last()->setData(chpnode.uniqueID(), Qt::UserRole+3);
-                    }
+    QList<QStandardItem*> row;
+    row << new QStandardItem(despline.title());                         // displayrole  ：显示文字
+    row.last()->setData(1, Qt::UserRole+1);                             // userrole+1   ：despline-mk
+    row.last()->setData(volumeIndex, Qt::UserRole+2);                   // userrole+2   ：起始卷宗
+    row.last()->setData(despline.uniqueID(), Qt::UserRole+3);           // userrole+3   ：despline-id
+    despline_summary_items.insert(despline.uniqueID(), row.last());
 
-                    points_row << new QStandardItem(QString("%1").arg(point.index()));
-                    points_row.last()->setData(point.uniqueID());
-                    points_row.last()->setEditable(false);
+    for (auto point : branchattach_hdl.getPointsViaDespline(despline))
+        row.first()->appendRow(attachpoint_summary_row(point));
 
-                    points_row << new QStandardItem(point.description());
+    row << new QStandardItem(QString("%1").arg(despline.index()));
+    row.last()->setData(despline.uniqueID());
+    row.last()->setEditable(false);
 
-                    if(chpnode.isValid()){
-                        points_row << new QStandardItem(chpnode.parent().title());
-                        points_row.last()->setEditable(false);
+    row << new QStandardItem(despline.description());
 
-                        points_row << new QStandardItem(chpnode.title());
-                        points_row.last()->setEditable(false);
-                    }
-                    else {
-                        points_row << new QStandardItem("未吸附");
-                        points_row.last()->setEditable(false);
+    row << new QStandardItem(volume.title());
+    row.last()->setEditable(false);
 
-                        points_row << new QStandardItem("未吸附");
-                        points_row.last()->setEditable(false);
-                    }
-                    auto attached_b = point.attachedStoryblock();
-                    points_row << new QStandardItem(attached_b.isValid()?
-                                                        attached_b.title():"未吸附");
+    row << new QStandardItem("———————————————");
+    row.last()->setEditable(false);
+    row << new QStandardItem("———————————————");
+    row.last()->setEditable(false);
 
-                    if(chpnode.isValid() && attached_b.isValid())
-                        points_row.first()->setIcon(QIcon(":/foreshadow/icon/okpic.png"));
-                    else
-                        points_row.first()->setIcon(QIcon(":/foreshadow/icon/cyclepic.png"));
+    reset_despline_summary_state(row.first());
+    return row;
+}
 
-                    row.last()->appendRow(points_row);
-                }
-            }
+QList<QStandardItem *> NovelHost::attachpoint_summary_row(const DBAccess::BranchAttachPoint &point)
+{
+    QList<QStandardItem*> points_row;
+    points_row << new QStandardItem(point.title());
+    points_row.last()->setData(2, Qt::UserRole+1);
+    attachpoint_summary_items.insert(point.uniqueID(), points_row.last());
 
+    points_row << new QStandardItem(QString("%1").arg(point.index()));
+    points_row.last()->setData(point.uniqueID());
+    points_row.last()->setEditable(false);
 
-            row << new QStandardItem(QString("%1").arg(despline_one.index()));
-            row.last()->setData(despline_one.uniqueID());
-            row.last()->setEditable(false);
+    points_row << new QStandardItem(point.description());
 
-            row << new QStandardItem(despline_one.description());
+    points_row << new QStandardItem("未吸附");
+    points_row.last()->setEditable(false);
+    points_row << new QStandardItem("未吸附");
+    points_row.last()->setEditable(false);
+    points_row << new QStandardItem("未吸附");
 
-            row << new QStandardItem(despline_one.parent().title());
-            row.last()->setEditable(false);
+    fill_attachpoint_summary(points_row, point);
+    return points_row;
+}
 
-            row << new QStandardItem("———————————————");
-            row.last()->setEditable(false);
-            row << new QStandardItem("———————————————");
-            row.last()->setEditable(false);
+void NovelHost::fill_attachpoint_summary(const QList<QStandardItem *> &row, const DBAccess::BranchAttachPoint &point)
+{
+    auto chpnode = point.attachedChapter();
+    auto attached_b = point.attachedStoryblock();
 
-            desplines_fuse_source_model->appendRow(row);
-        }
+    if(!chpnode.isValid()){
+        row.at(0)->setData(QVariant(), Qt::UserRole+2);
+        row.at(0)->setData(QVariant(), Qt::UserRole+3);
+        row.at(3)->setText("未吸附");
+        row.at(4)->setText("未吸附");
+    }
+    else {
+        auto volume = chpnode.parent();
+        row.at(0)->setData(volume.index(), Qt::UserRole+2);
+        row.at(0)->setData(chpnode.uniqueID(), Qt::UserRole+3);
+        row.at(3)->setText(volume.title());
+        row.at(4)->setText(chpnode.title());
     }
+
+    row.at(5)->setData(attached_b.isValid()?attached_b.uniqueID():QVariant());
+    row.at(5)->setText(attached_b.isValid()?attached_b.title():"未吸附");
+
+    if(chpnode.isValid() && attached_b.isValid())
+        row.at(0)->setIcon(QIcon(":/foreshadow/icon/okpic.png"));
+    else
+        row.at(0)->setIcon(QIcon(":/foreshadow/icon/cyclepic.png"));
 }
 
-ConfigHost &NovelHost::getConfigHost() const {
-    return config_host;
+void NovelHost::reset_attachpoint_summary(const DBAccess::BranchAttachPoint &point)
+{
+    auto item = attachpoint_summary_items.value(point.uniqueID());
+    if(!item)
+        return;
+
+    auto despline_item = item->parent();
+    QList<QStandardItem*> row;
+    for (int column=0; column<despline_item->columnCount(); ++column)
+        row << despline_item->child(item->row(), column);
+
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
+    fill_attachpoint_summary(row, point);
+    reset_despline_summary_state(despline_item);
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
 }
 
-void NovelHost::testMethod()
+void NovelHost::reset_despline_summary_state(QStandardItem *despline_item)
 {
-    try {
-        for (auto index=0; index<desplines_filter_under_volume->rowCount(); ++index) {
-            for (auto colidx=0; colidx<desplines_filter_under_volume->columnCount(); ++colidx) {
-                qDebug() << desplines_filter_under_volume->flags(desplines_filter_under_volume->index(index, colidx));
-            }
-            qDebug() << "=================================";
+    // 图标、驻点序号与吸附概要均由现有子行推算，不访问数据库
+    DesplineSummary summary;
+    summary.start_volume = despline_item->data(Qt::UserRole+2).toInt();
+    summary.suspended_count = 0;
+
+    QIcon icon(":/foreshadow/icon/云朵.png");
+    if(despline_item->rowCount())
+        icon = QIcon(":/foreshadow/icon/okpic.png");
+
+    for (int row=0; row<despline_item->rowCount(); ++row) {
+        auto point_item = despline_item->child(row);
+        auto chapter_id = point_item->data(Qt::UserRole+3);
+        if(!chapter_id.isValid()){
+            icon = QIcon(":/foreshadow/icon/曲别针.png");
+            summary.suspended_count++;
+        }
+        else {
+            summary.attached_chapters[chapter_id.toInt()]++;
+            summary.attached_volumes[point_item->data(Qt::UserRole+2).toInt()]++;
         }
 
-    } catch (WsException *e) {
-        qDebug() << e->reason();
+        auto index_item = despline_item->child(row, 1);
+        if(index_item && index_item->text() != QString("%1").arg(row))
+            index_item->setText(QString("%1").arg(row));
     }
-}
+    despline_item->setIcon(icon);
 
-void NovelHost::appendActiveTask(const QString &taskMask, int number)
-{
-    emit taskAppended(taskMask, number);
+    auto despline_id = despline_item->data(Qt::UserRole+3).toInt();
+    if(despline_summaries.contains(despline_id) && despline_summaries.value(despline_id) == summary)
+        return;
+
+    despline_summaries.insert(despline_id, summary);
+    if(despline_coverage.isValid())
+        despline_coverage.resetDespline(despline_id, summary);
+    // 概要变化后令过滤模型重新判定本行
+    if(despline_item->model()){
+        auto index = despline_item->index();
+        emit desplines_fuse_source_model->dataChanged(index, index);
+    }
 }
 
-void NovelHost::finishActiveTask(const QString &taskMask, const QString &finalTip, int number)
+void NovelHost::renumber_desplines_summary(int volumeIndex)
 {
-    emit taskFinished(taskMask, finalTip, number);
-}
+    int despline_index = 0;
+    for (int row=0; row<desplines_fuse_source_model->rowCount(); ++row) {
+        auto item = desplines_fuse_source_model->item(row);
+        if(item->data(Qt::UserRole+2).toInt() != volumeIndex)
+            continue;
 
-void NovelHost::acceptEditingTextblock(const QTextCursor &cursor){
-    current_editing_textblock = cursor.block();
+        auto index_item = desplines_fuse_source_model->item(row, 1);
+        if(index_item->text() != QString("%1").arg(despline_index))
+            index_item->setText(QString("%1").arg(despline_index));
+        despline_index++;
+    }
 }
 
-void NovelHost::_listen_basic_datamodel_changed(QStandardItem *item)
+void NovelHost::insert_despline_summary(const DBAccess::StoryTreeNode &despline, const DBAccess::StoryTreeNode &volume, int volumeIndex)
+{
+    // 汇总模型按卷宗顺序排列，插入至后续卷宗首行之前
+    int row = 0;
+    for (; row<desplines_fuse_source_model->rowCount(); ++row) {
+        if(desplines_fuse_source_model->item(row)->data(Qt::UserRole+2).toInt() > volumeIndex)
+            break;
+    }
+
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
+    desplines_fuse_source_model->insertRow(row, despline_summary_row(despline, volume, volumeIndex));
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
+}
+
+void NovelHost::sync_desplines_summary_title(const DBAccess::StoryTreeNode &node, const QString &title)
+{
+    disconnect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+               this,                           &NovelHost::_listen_basic_datamodel_changed);
+
+    switch (node.type()) {
+        case TnType::VOLUME:{
+                auto volume_index = node.index();
+                for (auto item : despline_summary_items) {
+                    if(item->data(Qt::UserRole+2).toInt() == volume_index)
+                        desplines_fuse_source_model->item(item->row(), 3)->setText(title);
+                }
+                for (auto item : attachpoint_summary_items) {
+                    auto volume_mark = item->data(Qt::UserRole+2);
+                    if(volume_mark.isValid() && volume_mark.toInt() == volume_index)
+                        item->parent()->child(item->row(), 3)->setText(title);
+                }
+            }break;
+        case TnType::CHAPTER:
+            for (auto item : attachpoint_summary_items) {
+                if(item->data(Qt::UserRole+3) == node.uniqueID())
+                    item->parent()->child(item->row(), 4)->setText(title);
+            }
+            break;
+        case TnType::STORYBLOCK:
+            for (auto item : attachpoint_summary_items) {
+                auto storyblock_item = item->parent()->child(item->row(), 5);
+                if(storyblock_item->data() == node.uniqueID())
+                    storyblock_item->setText(title);
+            }
+            break;
+        default:
+            break;
+    }
+
+    connect(desplines_fuse_source_model,    &QStandardItemModel::itemChanged,
+            this,                           &NovelHost::_listen_basic_datamodel_changed);
+}
+
+void NovelHost::refresh_despline_coverage()
 {
-    auto index_and_id_index = item->index().sibling(item->row(), 1);
-    auto all_value_index = item->index().sibling(item->row(), 0);
+    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
+    QList<int> volume_chapter_counts;
+    for (int vm_index=0; vm_index<chapters_navigate_treemodel->rowCount(); ++vm_index)
+        volume_chapter_counts << chapters_navigate_treemodel->item(vm_index)->rowCount();
+
+    despline_coverage.resetChapters(storytree_hdl.chapterSequence(), volume_chapter_counts);
+    for (auto it=despline_summaries.constBegin(); it!=despline_summaries.constEnd(); ++it)
+        despline_coverage.resetDespline(it.key(), it.value());
+}
+
+QAbstractItemModel *NovelHost::desplinesCoverageChart()
+{
+    if(!despline_coverage.isValid())
+        refresh_despline_coverage();
+
+    if(!desplines_coverage_model->columnCount())
+        desplines_coverage_model->setHorizontalHeaderLabels(QStringList() << "章卷名称" << "开启" << "闭合" << "未闭合");
+
+    // 原位更新既有行，仅补齐或裁剪行数差异
+    auto fill_row = [](QStandardItem *parent, int row, const QString &title, const DesplineCoverage::Counts &counts){
+        QStringList texts;
+        texts << title << QString("%1").arg(counts.opened) << QString("%1").arg(counts.closed) << QString("%1").arg(counts.remain);
+        if(row == parent->rowCount()){
+            QList<QStandardItem*> items;
+            for (auto text : texts) {
+                items << new QStandardItem(text);
+                items.last()->setEditable(false);
+            }
+            parent->appendRow(items);
+            return;
+        }
+        for (int column=0; column<texts.size(); ++column) {
+            auto item = parent->child(row, column);
+            if(item->text() != texts.at(column))
+                item->setText(texts.at(column));
+        }
+    };
+
+    auto root = desplines_coverage_model->invisibleRootItem();
+    int ordinal = 0;
+    for (int vm_index=0; vm_index<chapters_navigate_treemodel->rowCount(); ++vm_index) {
+        auto chapters_volume_node = chapters_navigate_treemodel->item(vm_index);
+        fill_row(root, vm_index, chapters_volume_node->text(), despline_coverage.volumeCounts(vm_index));
+
+        auto volume_row = root->child(vm_index);
+        for (int chp_index=0; chp_index<chapters_volume_node->rowCount(); ++chp_index, ++ordinal) {
+            auto chapters_chp_node = chapters_volume_node->child(chp_index);
+            fill_row(volume_row, chp_index, chapters_chp_node->text(), despline_coverage.chapterCounts(ordinal));
+        }
+        if(volume_row->rowCount() > chapters_volume_node->rowCount())
+            volume_row->removeRows(chapters_volume_node->rowCount(), volume_row->rowCount() - chapters_volume_node->rowCount());
+    }
+    if(root->rowCount() > chapters_navigate_treemodel->rowCount())
+        root->removeRows(chapters_navigate_treemodel->rowCount(), root->rowCount() - chapters_navigate_treemodel->rowCount());
+
+    return desplines_coverage_model;
+}
+
+ConfigHost &NovelHost::getConfigHost() const {
+    return config_host;
+}
+
+void NovelHost::testMethod()
+{
+    try {
+        for (auto index=0; index<desplines_filter_under_volume->rowCount(); ++index) {
+            for (auto colidx=0; colidx<desplines_filter_under_volume->columnCount(); ++colidx) {
+                qDebug() << desplines_filter_under_volume->flags(desplines_filter_under_volume->index(index, colidx));
+            }
+            qDebug() << "=================================";
+        }
+
+    } catch (WsException *e) {
+        qDebug() << e->reason();
+    }
+}
+
+void NovelHost::appendActiveTask(const QString &taskMask, int number)
+{
+    emit taskAppended(taskMask, number);
+}
+
+void NovelHost::finishActiveTask(const QString &taskMask, const QString &finalTip, int number)
+{
+    emit taskFinished(taskMask, finalTip, number);
+}
+
+void NovelHost::acceptEditingTextblock(const QTextCursor &cursor){
+    current_editing_textblock = cursor.block();
+}
+
+void NovelHost::_listen_basic_datamodel_changed(QStandardItem *item)
+{
+    auto index_and_id_index = item->index().sibling(item->row(), 1);
+    auto all_value_index = item->index().sibling(item->row(), 0);
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     DBAccess::BranchAttachController branchattach_hdl(*desp_ins);
 
@@ -1679,12 +2681,11 @@ void NovelHost::_listen_basic_datamodel_changed(QStandardItem *item)
                 if(item->data().isValid()){
                     auto storyblock = storytree_hdl.getNodeViaID(item->data().toInt());
                     branchattach_hdl.resetStoryblockOf(attached_point, storyblock);
-                    item->setText(storyblock.title());
                 }
                 else {
                     branchattach_hdl.resetStoryblockOf(attached_point, DBAccess::StoryTreeNode());
-                    item->setText("未吸附");
                 }
+                reset_attachpoint_summary(attached_point);
             }break;
         default:
             throw new WsException("错误数据");
@@ -1696,22 +2697,17 @@ void NovelHost::outlines_node_title_changed(QStandardItem *item)
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     auto struct_node = _locate_outline_handle_via(item);
     storytree_hdl.resetTitleOf(struct_node, item->text());
+    sync_desplines_summary_title(struct_node, item->text());
 
-    auto blk = volume_outlines_present->firstBlock();
-    while (blk.isValid()) {
-        if(blk.userData()){
-            if(blk.text() == item->text())
-                break;
+    auto doc = cached_volume_outlines_of(item);
+    if(!doc)
+        return;
 
-            auto data_key = static_cast<WsBlockData*>(blk.userData());
-            if(data_key->navigateIndex() == item->index()){
-                QTextCursor cur(blk);
-                cur.select(QTextCursor::BlockUnderCursor);
-                cur.insertText(item->text());
-                break;
-            }
-        }
-        blk = blk.next();
+    auto blk = volume_outlines_title_block(doc, item);
+    if(blk.isValid() && blk.text() != item->text()){
+        QTextCursor cur(blk);
+        cur.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+        cur.insertText(item->text());
     }
 }
 
@@ -1720,35 +2716,29 @@ void NovelHost::chapters_node_title_changed(QStandardItem *item){
         return;
 
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
-    auto root = storytree_hdl.novelNode();
     switch (indexDepth(item->index())) {
         case 1:{
-                auto volume_struct = root.childAt(TnType::VOLUME, item->row());
+                auto volume_struct = _locate_chapters_handle_via(item);
                 storytree_hdl.resetTitleOf(volume_struct, item->text());
+                sync_desplines_summary_title(volume_struct, item->text());
 
-                auto peer_index = outline_navigate_treemodel->index(item->row(), 0);
-                auto blk = volume_outlines_present->firstBlock();
-                while (blk.isValid()) {
-                    if(blk.userData()){
-                        if(blk.text() == item->text())
-                            break;
-
-                        auto data_key = static_cast<WsBlockData*>(blk.userData());
-                        if(data_key->navigateIndex() == peer_index){
-                            QTextCursor cur(blk);
-                            cur.select(QTextCursor::BlockUnderCursor);
-                            cur.insertText(item->text());
-                            break;
-                        }
-                    }
-                    blk = blk.next();
+                auto peer_item = outline_navigate_treemodel->item(item->row());
+                auto doc = cached_volume_outlines_of(peer_item);
+                if(!doc)
+                    break;
+
+                auto blk = volume_outlines_title_block(doc, peer_item);
+                if(blk.isValid() && blk.text() != item->text()){
+                    QTextCursor cur(blk);
+                    cur.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+                    cur.insertText(item->text());
                 }
             }
             break;
         case 2:{
-                auto volume_struct = root.childAt(TnType::VOLUME, item->parent()->row());
-                auto struct_chapter = volume_struct.childAt(TnType::CHAPTER, item->row());
+                auto struct_chapter = _locate_chapters_handle_via(item);
                 storytree_hdl.resetTitleOf(struct_chapter, item->text());
+                sync_desplines_summary_title(struct_chapter, item->text());
             }
             break;
     }
@@ -1756,13 +2746,12 @@ void NovelHost::chapters_node_title_changed(QStandardItem *item){
 
 QPair<OutlinesItem *, ChaptersItem *> NovelHost::insert_volume(const DBAccess::StoryTreeNode &volume_handle, int index)
 {
-    auto outline_volume_node = new OutlinesItem(volume_handle);
+    auto outline_volume_node = new_outlines_item(volume_handle);
 
     QList<QStandardItem*> navigate_valume_row;
-    auto node_navigate_volume_node = new ChaptersItem(*this, volume_handle, true);
+    auto node_navigate_volume_node = new_chapters_item(volume_handle, true);
     navigate_valume_row << node_navigate_volume_node;
-    navigate_valume_row << new QStandardItem("-");
-    navigate_valume_row.last()->setEditable(false);
+    navigate_valume_row << new WordsCountItem(*this);
 
 
     if(index >= outline_navigate_treemodel->rowCount()){
@@ -1782,7 +2771,7 @@ void NovelHost::listen_novel_description_change()
 {
     DBAccess::StoryTreeController storytree_hdl(*desp_ins);
     auto content = novel_outlines_present->toPlainText();
-    storytree_hdl.resetDescriptionOf(storytree_hdl.novelNode(), content);
+    description_write_behind->postValue(storytree_hdl.novelNode(), WriteBehindBuffer::Field::DESCRIPTION, content);
 }
 
 // 向卷宗细纲填充内容
@@ -1792,25 +2781,17 @@ void NovelHost::set_current_volume_outlines(const DBAccess::StoryTreeNode &node_
 
     if(node_under_volume.type() == TnType::VOLUME){
         current_volume_node = node_under_volume;
+        description_write_behind->flush();
 
-        disconnect(volume_outlines_present,  &QTextDocument::contentsChange,
-                   this,   &NovelHost::listen_volume_outlines_description_change);
-        disconnect(volume_outlines_present,  &QTextDocument::blockCountChanged,
-                   this,    &NovelHost::listen_volume_outlines_structure_changed);
-
-        volume_outlines_present->clear();
-        QTextCursor cursor(volume_outlines_present);
+        auto volume_item = outline_items_index.value(node_under_volume.uniqueID());
+        auto previous = volume_outlines_present;
+        volume_outlines_listening(false);
+        volume_outlines_present = volume_outlines_doc(volume_item);
+        volume_outlines_listening(true);
 
-        int volume_index = node_under_volume.index();
-        auto volume_node = outline_navigate_treemodel->item(volume_index);
-        insert_description_at_volume_outlines_doc(cursor, static_cast<OutlinesItem*>(volume_node));
-        volume_outlines_present->setModified(false);
-        volume_outlines_present->clearUndoRedoStacks();
-
-        connect(volume_outlines_present, &QTextDocument::contentsChange,
-                this,   &NovelHost::listen_volume_outlines_description_change);
-        connect(volume_outlines_present,  &QTextDocument::blockCountChanged,
-                this,    &NovelHost::listen_volume_outlines_structure_changed);
+        // 初始占位文档不入缓存
+        if(previous != volume_outlines_present && volume_outlines_cache.key(previous, -1) < 0)
+            previous->deleteLater();
 
         emit currentVolumeActived();
         return;
@@ -1820,11 +2801,14 @@ void NovelHost::set_current_volume_outlines(const DBAccess::StoryTreeNode &node_
 }
 
 ChaptersItem::ChaptersItem(NovelHost &host, const DBAccess::StoryTreeNode &refer, bool isGroup)
-    :host(host)
+    :ChaptersItem(host, refer.uniqueID(), isGroup?DBAccess::StoryTreeNode::Type::VOLUME:refer.type(), refer.title()){}
+
+ChaptersItem::ChaptersItem(NovelHost &host, int id, DBAccess::StoryTreeNode::Type type, const QString &title)
+    :host(host), node_id(id), node_type(type)
 {
-    setText(refer.title());
+    setText(title);
 
-    if(isGroup){
+    if(type == DBAccess::StoryTreeNode::Type::VOLUME){
         setIcon(QApplication::style()->standardIcon(QStyle::SP_DirIcon));
     }
     else {
@@ -1832,27 +2816,82 @@ ChaptersItem::ChaptersItem(NovelHost &host, const DBAccess::StoryTreeNode &refer
     }
 }
 
+int ChaptersItem::uniqueID() const
+{
+    return node_id;
+}
+
+DBAccess::StoryTreeNode::Type ChaptersItem::nodeType() const
+{
+    return node_type;
+}
 
 void ChaptersItem::calcWordsCount()
 {
     auto parent = QStandardItem::parent();
 
     if(!parent){    // 卷宗节点
-        int number = 0;
-        for (auto index = 0; index<rowCount(); ++index) {
-            auto child_item = static_cast<ChaptersItem*>(child(index));
-            child_item->calcWordsCount();
-            number += child(index, 1)->text().toInt();
-        }
-        model()->item(row(), 1)->setText(QString("%1").arg(number));
+        for (auto index = 0; index<rowCount(); ++index)
+            static_cast<ChaptersItem*>(child(index))->calcWordsCount();
+        static_cast<WordsCountItem*>(model()->item(row(), 1))->invalidate();
     }
     else {
-        QString content = host.chapterActiveText(index());
+        static_cast<WordsCountItem*>(parent->child(row(), 1))->invalidate();
+    }
+}
+
+WordsCountItem::WordsCountItem(NovelHost &host)
+    :host(host), words_count(-1), words_partial(false)
+{
+    setEditable(false);
+}
 
+QVariant WordsCountItem::data(int role) const
+{
+    if(role != Qt::DisplayRole || !model())
+        return QStandardItem::data(role);
+
+    if(words_count == -1){
         auto pitem = QStandardItem::parent();
-        auto cnode = pitem->child(row(), 1);
-        cnode->setText(QString("%1").arg(host.calcValidWordsCount(content)));
+        if(!pitem){     // 卷宗节点，汇总其下章节
+            auto volume = model()->item(row());
+            words_count = 0;
+            words_partial = false;
+            for (auto index = 0; index<volume->rowCount(); ++index) {
+                auto value = volume->child(index, 1)->data(Qt::DisplayRole);
+                if(value.type() == QVariant::Int)
+                    words_count += value.toInt();
+                else
+                    words_partial = true;
+            }
+        }
+        else {
+            // 未载入且无存储字数的章节不读取正文，待打开或刷新统计后显示
+            words_count = host.chapterWordsCount(pitem->child(row())->index());
+            if(words_count < 0)
+                words_count = -2;
+        }
     }
+
+    if(words_count == -2)
+        return "-";
+    if(words_partial)
+        return QString("%1+").arg(words_count);
+    return words_count;
+}
+
+void WordsCountItem::invalidate()
+{
+    // 未缓存说明视图自上次废弃后未曾取值，卷宗缓存亦必然已废弃；-2为已取值但字数未知
+    if(words_count == -1)
+        return;
+
+    words_count = -1;
+    emitDataChanged();
+
+    auto pitem = QStandardItem::parent();
+    if(pitem)
+        static_cast<WordsCountItem*>(model()->item(pitem->row(), 1))->invalidate();
 }
 
 // highlighter collect ===========================================================================
@@ -1875,8 +2914,10 @@ void WordsRenderWorker::run()
 
         QTextCharFormat format2;
         config_symbo.keywordsFormat(format2);
-        auto keywords = config_symbo.getKeywordsWithMSG();
-        keywords_highlighter_render(content_stored, keywords, format2, rst);
+        QList<std::tuple<QString, int, int, int>> hits;
+        config_symbo.matchKeywords(content_stored, hits);
+        for (auto hit : hits)
+            rst.append(std::make_tuple(std::get<0>(hit), std::get<1>(hit), format2, std::get<2>(hit), std::get<3>(hit)));
 
         poster_stored->acceptRenderResult(content_stored, rst);
         emit renderFinished(placeholder);
@@ -1968,9 +3009,13 @@ void WordsRender::highlightBlock(const QString &text)
 }
 
 OutlinesItem::OutlinesItem(const DBAccess::StoryTreeNode &refer)
+    :OutlinesItem(refer.uniqueID(), refer.type(), refer.title()){}
+
+OutlinesItem::OutlinesItem(int id, DBAccess::StoryTreeNode::Type type, const QString &title)
+    :node_id(id), node_type(type)
 {
-    setText(refer.title());
-    switch (refer.type()) {
+    setText(title);
+    switch (type) {
         case DBAccess::StoryTreeNode::Type::KEYPOINT:
             setIcon(QIcon(":/outlines/icon/点.png"));
             break;
@@ -1988,21 +3033,20 @@ OutlinesItem::OutlinesItem(const DBAccess::StoryTreeNode &refer)
     }
 }
 
-
-
-WsBlockData::WsBlockData(const QModelIndex &target, WsBlockData::Type blockType)
-    :outline_index(target), block_type(blockType){}
-
-bool WsBlockData::operator==(const WsBlockData &other) const
+int OutlinesItem::uniqueID() const
 {
-    return outline_index == other.outline_index;
+    return node_id;
 }
 
-QModelIndex WsBlockData::navigateIndex() const
+DBAccess::StoryTreeNode::Type OutlinesItem::nodeType() const
 {
-    return outline_index;
+    return node_type;
 }
 
+
+WsBlockData::WsBlockData(WsBlockData::Type blockType)
+    :block_type(blockType){}
+
 WsBlockData::Type WsBlockData::blockType() const
 {
     return block_type;
@@ -2042,14 +3086,677 @@ void OutlinesRender::highlightBlock(const QString &text)
 
 
 
+WriteBehindBuffer::WriteBehindBuffer(int idleMsecs, QObject *parent)
+    :QObject(parent), desp_ins(nullptr), idle_timer(new QTimer(this))
+{
+    idle_timer->setSingleShot(true);
+    idle_timer->setInterval(idleMsecs);
+    connect(idle_timer, &QTimer::timeout,   [this]{
+        WsExcept(flush());
+    });
+}
+
+void WriteBehindBuffer::resetAccessBase(DBAccess *desp)
+{
+    if(desp_ins && desp_ins != desp)
+        flush();
+
+    desp_ins = desp;
+}
+
+void WriteBehindBuffer::postValue(const DBAccess::StoryTreeNode &node, WriteBehindBuffer::Field field, const QString &value)
+{
+    if(!node.isValid())
+        throw new WsException("传入节点无效");
+
+    pending_values.insert(qMakePair(node.uniqueID(), static_cast<int>(field)), qMakePair(node, value));
+    idle_timer->start();
+}
+
+void WriteBehindBuffer::flush()
+{
+    idle_timer->stop();
+    if(!desp_ins || pending_values.isEmpty())
+        return;
+
+    auto values = pending_values;
+    pending_values.clear();
+
+    DBAccess::StoryTreeController storytree_hdl(*desp_ins);
+    for (auto it=values.constBegin(); it!=values.constEnd(); ++it) {
+        switch (static_cast<Field>(it.key().second)) {
+            case Field::TITLE:
+                storytree_hdl.resetTitleOf(it.value().first, it.value().second);
+                break;
+            case Field::DESCRIPTION:
+                storytree_hdl.resetDescriptionOf(it.value().first, it.value().second);
+                break;
+        }
+    }
+}
+
+
+BackupWorker::BackupWorker(const QString &sourcePath, const QString &targetDir, int generations)
+    :source_path(sourcePath), target_dir(targetDir), generations_count(generations)
+{
+    setAutoDelete(true);
+}
+
+void BackupWorker::run()
+{
+    auto base_name = QFileInfo(source_path).completeBaseName();
+    QDir dir(target_dir);
+    if(!dir.exists() && !dir.mkpath(".")){
+        emit backupFinished(false, QString("无法建立备份目录：%1").arg(target_dir));
+        return;
+    }
+
+    auto final_path = dir.filePath(QString("%1.%2.wsnf").arg(base_name)
+                                   .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")));
+    auto temp_path = final_path + ".part";
+
+    // 经由Qt SQLite驱动建立独立连接，与编辑连接共用同一份SQLite库
+    auto connection_name = QString("novel-backup-%1").arg(reinterpret_cast<quintptr>(this));
+    QString failure;
+    bool completed = false;
+    {
+        auto target = QSqlDatabase::addDatabase("QSQLITE", connection_name);
+        target.setConnectOptions("QSQLITE_BUSY_TIMEOUT=200");
+        target.setDatabaseName(temp_path);
+
+        QFile::remove(temp_path);
+        if(!target.open())
+            failure = target.lastError().text();
+        else{
+            completed = copy_snapshot(target, failure);
+            target.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connection_name);
+
+    if(!completed){
+        QFile::remove(temp_path);
+        emit backupFinished(false, QString("备份失败：%1").arg(failure));
+        return;
+    }
+    if(!QFile::rename(temp_path, final_path)){
+        QFile::remove(temp_path);
+        emit backupFinished(false, QString("备份文件无法写入：%1").arg(final_path));
+        return;
+    }
+
+    rotate_generations(base_name);
+    emit backupFinished(true, QString("备份完成：%1").arg(final_path));
+}
+
+bool BackupWorker::copy_snapshot(QSqlDatabase &target, QString &failure)
+{
+    // 每批复制行数与批间间隔，保证编辑连接不被长时间阻塞；锁等待重试有上限
+    const int rows_per_step = 512;
+    const unsigned long step_interval = 20;
+    const int busy_retry_limit = 50;
+
+    QSqlQuery sql(target);
+    auto exec_retry = [&](const QString &statement)->bool{
+        for (int busy = 0; busy < busy_retry_limit; ++busy) {
+            if(sql.exec(statement))
+                return true;
+
+            auto code = sql.lastError().nativeErrorCode().toInt() & 0xff;
+            if(code != 5 && code != 6){         // SQLITE_BUSY、SQLITE_LOCKED之外的错误不再重试
+                failure = sql.lastError().text();
+                return false;
+            }
+            QThread::msleep(step_interval);
+        }
+        failure = "作品文件长时间被锁定";
+        return false;
+    };
+    auto quoted = [](QString name){ return "\""+name.replace("\"", "\"\"")+"\""; };
+    auto src_path = source_path;
+    src_path.replace("'", "''");
+
+    if(!exec_retry(QString("attach database '%1' as src").arg(src_path)))
+        return false;
+
+    // 全程处于同一读事务，源库为WAL模式，快照固定于首次读取且不阻塞编辑连接的写入
+    if(!exec_retry("begin"))
+        return false;
+
+    // 结构：表先于索引、触发器
+    if(!exec_retry("select type, name, sql from src.sqlite_master where sql is not null and name not like 'sqlite_%' "
+                   "order by case type when 'table' then 0 else 1 end"))
+        return false;
+    QList<QString> tables, statements;
+    while (sql.next()) {
+        if(sql.value(0).toString() == "table")
+            tables << sql.value(1).toString();
+        statements << sql.value(2).toString();
+    }
+    for (auto statement : statements)
+        if(!exec_retry(statement))
+            return false;
+
+    qint64 total = 0, copied = 0;
+    for (auto table : tables) {
+        if(!exec_retry("select count(*) from src."+quoted(table)) || !sql.next())
+            return false;
+        total += sql.value(0).toLongLong();
+    }
+    emit backupProgress(0, static_cast<int>(total));
+
+    for (auto table : tables) {
+        qint64 last_rowid = std::numeric_limits<qint64>::min();
+        forever {
+            auto range = QString("select rowid from src.%1 where rowid>%2 order by rowid limit %3")
+                    .arg(quoted(table)).arg(last_rowid).arg(rows_per_step);
+            if(!exec_retry("select count(*), max(rowid) from ("+range+")") || !sql.next())
+                return false;
+            auto count = sql.value(0).toLongLong();
+            if(!count)
+                break;
+            auto upper = sql.value(1).toLongLong();
+
+            if(!exec_retry(QString("insert into main.%1 select * from src.%1 where rowid>%2 and rowid<=%3")
+                           .arg(quoted(table)).arg(last_rowid).arg(upper)))
+                return false;
+
+            last_rowid = upper;
+            copied += count;
+            emit backupProgress(static_cast<int>(copied), static_cast<int>(total));
+            QThread::msleep(step_interval);
+        }
+    }
+
+    if(!exec_retry("select count(*) from src.sqlite_master where name='sqlite_sequence'") || !sql.next())
+        return false;
+    if(sql.value(0).toInt() && !exec_retry("insert into main.sqlite_sequence select * from src.sqlite_sequence"))
+        return false;
+
+    return exec_retry("commit") && exec_retry("detach database src");
+}
+
+void BackupWorker::rotate_generations(const QString &baseName) const
+{
+    QDir dir(target_dir);
+    // 时间戳命名，按名称排序即按时间排序
+    auto generations = dir.entryList(QStringList() << QString("%1.*.wsnf").arg(baseName), QDir::Files, QDir::Name);
+    while (generations.size() > generations_count)
+        dir.remove(generations.takeFirst());
+}
+
+KeywordsTableModel::KeywordsTableModel(DBAccess *desp, const DBAccess::KeywordField &table, QObject *parent)
+    :QAbstractItemModel(parent), desp_ins(desp), table_define(table), display_index(-1), last_id(-1), exhausted(true)
+{
+    load_columns();
+}
+
+void KeywordsTableModel::resetQuery(const QString &queryWord)
+{
+    beginResetModel();
+    rows.clear();
+    last_id = -1;
+    exhausted = queryWord.isEmpty();
+
+    display_index = -1;
+    query_name = queryWord;
+    if(query_name.lastIndexOf("%") != -1){
+        query_name = queryWord.mid(0, queryWord.lastIndexOf("%"));
+        display_index = queryWord.mid(queryWord.lastIndexOf("%")+1).toInt();
+    }
+    if(display_index < 0 || display_index >= columns.size()) display_index = -1;
+
+    matched_ids.clear();
+    if(!exhausted && query_name != "*"){
+        DBAccess::KeywordController kwdl(*desp_ins);
+        for (auto pair : kwdl.keywordsContains(table_define, query_name))
+            matched_ids << pair.first;
+        exhausted = matched_ids.isEmpty();
+    }
+    endResetModel();
+}
+
+void KeywordsTableModel::refreshSchema()
+{
+    load_columns();
+    resetQuery(display_index < 0 ? query_name : QString("%1%%2").arg(query_name).arg(display_index));
+}
+
+void KeywordsTableModel::load_columns()
+{
+    table_name = table_define.tableName();
+    type_name = table_define.name();
+
+    columns.clear();
+    column_types.clear();
+    auto count = table_define.childCount();
+    for (auto index=0; index<count; ++index) {
+        columns << table_define.childAt(index);
+        column_types << columns.last().vType();
+    }
+}
+
+QString KeywordsTableModel::summary_of(const KeywordsTableModel::RowRecord &record) const
+{
+    if(display_index < 0)
+        return "-----------------";
+    return record.displays.at(display_index);
+}
+
+void KeywordsTableModel::setMentionsCounter(std::function<int (const QString &, int)> counter)
+{
+    mentions_counter = counter;
+    mentionsUpdated();
+}
+
+void KeywordsTableModel::mentionsUpdated()
+{
+    if(rows.isEmpty())
+        return;
+    emit dataChanged(index(0, 2, QModelIndex()), index(rows.size()-1, 2, QModelIndex()));
+}
+
+QModelIndex KeywordsTableModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if(column < 0 || column > 2 || row < 0)
+        return QModelIndex();
+
+    // 根行internalId为0，字段行internalId为所属根行序号+1
+    if(!parent.isValid()){
+        if(row >= rows.size())
+            return QModelIndex();
+        return createIndex(row, column, quintptr(0));
+    }
+
+    if(parent.internalId() || row >= columns.size())
+        return QModelIndex();
+    return createIndex(row, column, quintptr(parent.row()+1));
+}
+
+QModelIndex KeywordsTableModel::parent(const QModelIndex &child) const
+{
+    if(!child.isValid() || !child.internalId())
+        return QModelIndex();
+
+    return createIndex(static_cast<int>(child.internalId()-1), 0, quintptr(0));
+}
+
+int KeywordsTableModel::rowCount(const QModelIndex &parent) const
+{
+    if(!parent.isValid())
+        return rows.size();
+    if(parent.internalId() || parent.column())
+        return 0;
+    return columns.size();
+}
+
+int KeywordsTableModel::columnCount(const QModelIndex &) const
+{
+    return 3;
+}
+
+bool KeywordsTableModel::hasChildren(const QModelIndex &parent) const
+{
+    if(!parent.isValid())
+        return rows.size();
+    return !parent.internalId() && !parent.column() && columns.size();
+}
+
+QVariant KeywordsTableModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid())
+        return QVariant();
+
+    if(!index.internalId()){
+        auto &record = rows.at(index.row());
+        if(index.column() == 2){
+            if(role == Qt::DisplayRole && mentions_counter)
+                return mentions_counter(table_name, record.id);
+            return QVariant();
+        }
+        if(index.column()){
+            if(role == Qt::DisplayRole)
+                return summary_of(record);
+            return QVariant();
+        }
+
+        switch (role) {
+            case Qt::DisplayRole:
+            case Qt::EditRole:
+                return record.name;
+            case Qt::UserRole+1:
+                return record.id;
+            case Qt::UserRole+2:
+                return table_name;
+            case Qt::UserRole+3:
+                return type_name;
+        }
+        return QVariant();
+    }
+
+    auto &record = rows.at(static_cast<int>(index.internalId()-1));
+    if(index.column() == 2)
+        return QVariant();
+    if(!index.column()){
+        if(role == Qt::DisplayRole)
+            return columns.at(index.row()).name();
+        return QVariant();
+    }
+
+    switch (role) {
+        case Qt::DisplayRole:
+        case Qt::EditRole:
+            return record.displays.at(index.row());
+        case Qt::UserRole+1:
+            return record.values.at(index.row());
+        case Qt::UserRole+2:
+            return static_cast<int>(column_types.at(index.row()));
+    }
+    return QVariant();
+}
+
+bool KeywordsTableModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if(!index.isValid())
+        return false;
+
+    DBAccess::KeywordController kwdl(*desp_ins);
+    try {
+        if(!index.internalId()){
+            if(index.column() || role != Qt::EditRole)
+                return false;
+
+            auto &record = rows[index.row()];
+            kwdl.resetKeywordNameOf(table_define, record.id, value.toString());
+            record.name = value.toString();
+            emit dataChanged(index, index);
+            return true;
+        }
+
+        if(index.column() != 1 || role != Qt::UserRole+1)
+            return false;
+
+        auto &record = rows[static_cast<int>(index.internalId()-1)];
+        auto field_index = index.row();
+        auto display = kwdl.resetKeywordValueOf(table_define, record.id, field_index, value);
+        record.values[field_index] = value;
+        record.displays[field_index] = display;
+        emit dataChanged(index, index);
+
+        if(display_index == field_index){
+            auto summary = this->index(static_cast<int>(index.internalId()-1), 1, QModelIndex());
+            emit dataChanged(summary, summary);
+        }
+        return true;
+    } catch (WsException *e) {
+        qDebug() << e->reason();
+        return false;
+    }
+}
+
+Qt::ItemFlags KeywordsTableModel::flags(const QModelIndex &index) const
+{
+    if(!index.isValid())
+        return Qt::NoItemFlags;
+
+    auto flags = Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+    // 根行名称与字段值可编辑
+    if((!index.internalId() && !index.column()) || (index.internalId() && index.column() == 1))
+        flags |= Qt::ItemIsEditable;
+    return flags;
+}
+
+QVariant KeywordsTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+        case 0:
+            return QString("名称");
+        case 1:
+            return QString("数据");
+    }
+    return QString("提及");
+}
+
+bool KeywordsTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && !exhausted;
+}
+
+void KeywordsTableModel::fetchMore(const QModelIndex &parent)
+{
+    const int page_size = 200;
+    if(parent.isValid() || exhausted)
+        return;
+
+    // 键集分页：id升序，TABLEREF列通过LEFT JOIN取得引用名称
+    QString exstr = "select kw.id, kw.name", joinstr, refstr;
+    QList<QStringList> enum_values;
+    QHash<int, int> refname_columns;
+    for (auto index=0; index<columns.size(); ++index) {
+        exstr += QString(", kw.field_%1").arg(index);
+        enum_values << QStringList();
+
+        switch (column_types.at(index)) {
+            case DBAccess::KeywordField::ValueType::ENUM:
+                enum_values.last() = columns.at(index).supplyValue().split(";");
+                break;
+            case DBAccess::KeywordField::ValueType::TABLEREF:
+                refname_columns[index] = 2 + columns.size() + refname_columns.size();
+                joinstr += QString(" left join %1 ref%2 on kw.field_%2 = ref%2.id").arg(columns.at(index).supplyValue()).arg(index);
+                refstr += QString(", ref%1.name").arg(index);
+                break;
+            default:
+                break;
+        }
+    }
+    exstr += refstr + " from " + table_name + " kw" + joinstr + " where kw.id > :last";
+    if(query_name != "*"){
+        // 名称检索经n元索引得到有序id，逐页取用
+        QStringList ids;
+        auto start = std::upper_bound(matched_ids.constBegin(), matched_ids.constEnd(), last_id);
+        for (auto it=start; it!=matched_ids.constEnd() && ids.size()<page_size; ++it)
+            ids << QString::number(*it);
+        exstr += " and kw.id in (" + ids.join(",") + ")";
+    }
+    exstr += " order by kw.id limit :ps";
+
+    auto sql = desp_ins->getStatement();
+    sql.prepare(exstr);
+    sql.bindValue(":last", last_id);
+    sql.bindValue(":ps", page_size);
+    if(!sql.exec()){
+        qDebug() << sql.lastError().text();
+        exhausted = true;
+        return;
+    }
+
+    QList<RowRecord> page;
+    while (sql.next()) {
+        RowRecord record;
+        record.id = sql.value(0).toInt();
+        record.name = sql.value(1).toString();
+        for (auto index=0; index<columns.size(); ++index) {
+            auto value = sql.value(index+2);
+            record.values << value;
+
+            switch (column_types.at(index)) {
+                case DBAccess::KeywordField::ValueType::NUMBER:
+                case DBAccess::KeywordField::ValueType::STRING:
+                    record.displays << value.toString();
+                    break;
+                case DBAccess::KeywordField::ValueType::ENUM:{
+                        auto item_index = value.toInt();
+                        record.displays << (item_index >= 0 && item_index < enum_values.at(index).size()?
+                                                enum_values.at(index).at(item_index):QString("存储值超界"));
+                    }break;
+                case DBAccess::KeywordField::ValueType::TABLEREF:
+                    record.displays << (value.isNull()?QString("悬空"):sql.value(refname_columns[index]).toString());
+                    break;
+            }
+        }
+        page << record;
+    }
+
+    exhausted = page.size() < page_size;
+    if(page.isEmpty())
+        return;
+
+    last_id = page.last().id;
+    beginInsertRows(QModelIndex(), rows.size(), rows.size()+page.size()-1);
+    rows.append(page);
+    endInsertRows();
+}
+
+
+DesplineCoverage::DesplineCoverage()
+    :valid_state(false), prefix_dirty(true){}
+
+void DesplineCoverage::resetChapters(const QList<int> &chapterIDs, const QList<int> &volumeChapterCounts)
+{
+    chapter_ordinals.clear();
+    for (int ordinal=0; ordinal<chapterIDs.size(); ++ordinal)
+        chapter_ordinals.insert(chapterIDs.at(ordinal), ordinal);
+
+    volume_first_ordinals.clear();
+    int total = 0;
+    for (auto count : volumeChapterCounts) {
+        volume_first_ordinals << total;
+        total += count;
+    }
+    volume_first_ordinals << total;
+
+    // 末位收纳自无章节卷宗开启的支线
+    despline_spans.clear();
+    opened_counts.fill(0, total+1);
+    closed_counts.fill(0, total+1);
+    prefix_dirty = true;
+    valid_state = true;
+}
+
+void DesplineCoverage::resetDespline(int desplineID, const DesplineSummary &summary)
+{
+    removeDespline(desplineID);
+
+    auto chapters_total = volume_first_ordinals.last();
+    int open_ordinal = chapters_total, last_attached = -1;
+    if(summary.start_volume >= 0 && summary.start_volume < volume_first_ordinals.size()-1)
+        open_ordinal = volume_first_ordinals.at(summary.start_volume);
+
+    for (auto it=summary.attached_chapters.constBegin(); it!=summary.attached_chapters.constEnd(); ++it) {
+        auto ordinal = chapter_ordinals.value(it.key(), -1);
+        if(ordinal < 0)
+            continue;
+        open_ordinal = qMin(open_ordinal, ordinal);
+        last_attached = qMax(last_attached, ordinal);
+    }
+    int close_ordinal = (!summary.suspended_count && last_attached >= 0) ? last_attached : -1;
+
+    despline_spans.insert(desplineID, qMakePair(open_ordinal, close_ordinal));
+    opened_counts[open_ordinal]++;
+    if(close_ordinal >= 0)
+        closed_counts[close_ordinal]++;
+    prefix_dirty = true;
+}
+
+void DesplineCoverage::removeDespline(int desplineID)
+{
+    if(!despline_spans.contains(desplineID))
+        return;
+
+    auto span = despline_spans.take(desplineID);
+    opened_counts[span.first]--;
+    if(span.second >= 0)
+        closed_counts[span.second]--;
+    prefix_dirty = true;
+}
+
+void DesplineCoverage::clear()
+{
+    valid_state = false;
+    chapter_ordinals.clear();
+    volume_first_ordinals.clear();
+    despline_spans.clear();
+    opened_counts.clear();
+    closed_counts.clear();
+    prefix_dirty = true;
+}
+
+bool DesplineCoverage::isValid() const
+{
+    return valid_state;
+}
+
+DesplineCoverage::Counts DesplineCoverage::chapterCounts(int ordinal) const
+{
+    if(!valid_state || ordinal < 0 || ordinal >= volume_first_ordinals.last())
+        return Counts{0, 0, 0};
+    if(prefix_dirty)
+        rebuild_prefix();
+
+    return Counts{opened_counts.at(ordinal), closed_counts.at(ordinal),
+                prefix_of(opened_prefix, ordinal) - prefix_of(closed_prefix, ordinal)};
+}
+
+DesplineCoverage::Counts DesplineCoverage::volumeCounts(int volumeIndex) const
+{
+    if(!valid_state || volumeIndex < 0 || volumeIndex >= volume_first_ordinals.size()-1)
+        return Counts{0, 0, 0};
+    if(prefix_dirty)
+        rebuild_prefix();
+
+    auto first = volume_first_ordinals.at(volumeIndex);
+    auto last = volume_first_ordinals.at(volumeIndex+1) - 1;
+    return Counts{prefix_of(opened_prefix, last) - prefix_of(opened_prefix, first-1),
+                prefix_of(closed_prefix, last) - prefix_of(closed_prefix, first-1),
+                prefix_of(opened_prefix, last) - prefix_of(closed_prefix, last)};
+}
+
+void DesplineCoverage::rebuild_prefix() const
+{
+    opened_prefix.resize(opened_counts.size());
+    closed_prefix.resize(closed_counts.size());
+
+    int opened_sum = 0, closed_sum = 0;
+    for (int ordinal=0; ordinal<opened_counts.size(); ++ordinal) {
+        opened_sum += opened_counts.at(ordinal);
+        closed_sum += closed_counts.at(ordinal);
+        opened_prefix[ordinal] = opened_sum;
+        closed_prefix[ordinal] = closed_sum;
+    }
+    prefix_dirty = false;
+}
+
+int DesplineCoverage::prefix_of(const QVector<int> &prefix, int ordinal) const
+{
+    if(ordinal < 0)
+        return 0;
+    return prefix.at(ordinal);
+}
+
 DesplineFilterModel::DesplineFilterModel(DesplineFilterModel::Type operateType, QObject *parent)
     :QSortFilterProxyModel (parent), operate_type_store(operateType),
-      volume_filter_index(INT_MAX), chapter_filter_id(INT_MAX){}
+      volume_filter_index(INT_MAX), chapter_filter_id(INT_MAX), summary_index(nullptr){}
 
 void DesplineFilterModel::setFilterBase(const DBAccess::StoryTreeNode &volume_node, const DBAccess::StoryTreeNode & chapter_node)
 {
-    volume_filter_index = volume_node.index();
-    chapter_filter_id = chapter_node.isValid()?chapter_node.uniqueID():QVariant();
+    auto volume_index = volume_node.index();
+    QVariant chapter_id = chapter_node.isValid()?chapter_node.uniqueID():QVariant();
+    // 过滤条件未变化（如卷内切换章节时的卷宗过滤）无需重新过滤
+    if(volume_index == volume_filter_index &&
+            (operate_type_store != UNTILWITHCHAPTER || chapter_id == chapter_filter_id))
+        return;
+
+    volume_filter_index = volume_index;
+    chapter_filter_id = chapter_id;
+    invalidateFilter();
+}
+
+void DesplineFilterModel::setSummaryIndex(const QHash<int, DesplineSummary> *summaries)
+{
+    summary_index = summaries;
     invalidateFilter();
 }
 
@@ -2061,55 +3768,24 @@ bool DesplineFilterModel::filterAcceptsRow(int source_row, const QModelIndex &so
         return true; // 接受所有驻点
 
     auto parent_volume_index = sourceModel()->data(target_cell_index, Qt::UserRole+2).toInt();  // start-volume index
+    if(operate_type_store == UNDERVOLUME)
+        return volume_filter_index == parent_volume_index;
+    if(parent_volume_index > volume_filter_index)
+        return false;
 
+    auto despline_id = sourceModel()->data(target_cell_index, Qt::UserRole+3).toInt();
+    if(!summary_index || !summary_index->contains(despline_id))
+        return false;
+    auto &summary = (*summary_index)[despline_id];
+    if(summary.suspended_count)
+        return true;
 
     switch (operate_type_store) {
-        case UNDERVOLUME:
-            return volume_filter_index == parent_volume_index;
-        case UNTILWITHVOLUME:{
-                if(parent_volume_index > volume_filter_index)
-                    return false;
-
-                int suspend_point_remains = 0;
-                auto attach_point_count = sourceModel()->rowCount(target_cell_index);
-                for (auto point_index=0;point_index<attach_point_count;++point_index) {
-                    auto attach_point_model_index = sourceModel()->index(point_index, 0, target_cell_index);
-
-                    auto attach_chapter_id = sourceModel()->data(attach_point_model_index, Qt::UserRole+3);
-                    if(!attach_chapter_id.isValid())
-                        suspend_point_remains+=1;
-                    else {
-                        auto attach_volume_index = sourceModel()->data(attach_point_model_index, Qt::UserRole+2).toInt();
-                        if(attach_volume_index == volume_filter_index)
-                            return true;
-                    }
-                }
-
-                if(suspend_point_remains)
-                    return true;
-
-                return false;
-            }
-        case UNTILWITHCHAPTER:{
-                if(parent_volume_index > volume_filter_index)
-                    return false;
-
-                int suspend_point_remains = 0;
-                auto attach_point_count = sourceModel()->rowCount(target_cell_index);
-                for (auto point_index=0; point_index<attach_point_count; point_index++) {
-                    auto attach_point_model_index = sourceModel()->index(point_index, 0, target_cell_index);
-                    auto attach_chapter_id = sourceModel()->data(attach_point_model_index, Qt::UserRole+3);
-
-                    if(!attach_chapter_id.isValid())
-                        suspend_point_remains+=1;
-                    else if(attach_chapter_id == chapter_filter_id)
-                        return true;
-                }
-
-                if(suspend_point_remains)
-                    return true;
-
-                return false;
-            }
+        case UNTILWITHVOLUME:
+            return summary.attached_volumes.contains(volume_filter_index);
+        case UNTILWITHCHAPTER:
+            return chapter_filter_id.isValid() && summary.attached_chapters.contains(chapter_filter_id.toInt());
+        default:
+            return false;
     }
 }
@@ -10,32 +10,62 @@
 #include <QSortFilterProxyModel>
 #include <QStandardItemModel>
 #include <QSyntaxHighlighter>
+#include <QTimer>
+#include <functional>
 
 
 class NovelHost;
 
 namespace NovelBase {
 
-    class ChaptersItem : public QObject, public QStandardItem
+    class ChaptersItem : public QStandardItem
     {
-        Q_OBJECT
-
     public:
         ChaptersItem(NovelHost&host, const DBAccess::StoryTreeNode &refer, bool isGroup=false);
+        ChaptersItem(NovelHost&host, int id, DBAccess::StoryTreeNode::Type type, const QString &title);
         virtual ~ChaptersItem() override = default;
 
-    public slots:
+        int uniqueID() const;
+        DBAccess::StoryTreeNode::Type nodeType() const;
+
+        /**
+         * @brief 废弃本节点字数缓存，视图下次取值时重新统计
+         */
         void calcWordsCount();
 
     private:
         NovelHost &host;
+        const int node_id;
+        const DBAccess::StoryTreeNode::Type node_type;
     };
-    class OutlinesItem : public QObject, public QStandardItem
+    /**
+     * @brief 章卷字数列，仅在视图取值时统计并缓存，卷宗取其下章节之和
+     */
+    class WordsCountItem : public QStandardItem
     {
-        Q_OBJECT
+    public:
+        WordsCountItem(NovelHost &host);
 
+        virtual QVariant data(int role = Qt::UserRole + 1) const override;
+        void invalidate();
+
+    private:
+        NovelHost &host;
+        mutable int words_count;        // -1未缓存，-2章节字数未知
+        mutable bool words_partial;     // 卷宗节点：存在字数未知的章节
+    };
+    class OutlinesItem : public QStandardItem
+    {
     public:
         OutlinesItem(const DBAccess::StoryTreeNode &refer);
+        OutlinesItem(int id, DBAccess::StoryTreeNode::Type type, const QString &title);
+
+        int uniqueID() const;
+        DBAccess::StoryTreeNode::Type nodeType() const;
+
+    private:
+        const int node_id;
+        const DBAccess::StoryTreeNode::Type node_type;
     };
 
     class OutlinesRender : public QSyntaxHighlighter
@@ -100,19 +130,209 @@ namespace NovelBase {
     {
     public:
         using Type = DBAccess::StoryTreeNode::Type;
-        WsBlockData(const QModelIndex &target, Type blockType);
+        WsBlockData(Type blockType);
         virtual ~WsBlockData() = default;
 
-        bool operator==(const WsBlockData &other) const;
-
-        QModelIndex navigateIndex() const;
         Type blockType() const;
 
     private:
-        const QModelIndex outline_index;   // 指向大纲树节点
         Type block_type;
     };
 
+    /**
+     * @brief 描述内容延迟写入缓冲：按(节点,字段)保留最新值，空闲超时或保存时合并写入
+     */
+    class WriteBehindBuffer : public QObject
+    {
+    public:
+        enum class Field{
+            TITLE = 0,
+            DESCRIPTION = 1
+        };
+
+        explicit WriteBehindBuffer(int idleMsecs, QObject *parent=nullptr);
+        virtual ~WriteBehindBuffer() override = default;
+
+        void resetAccessBase(DBAccess *desp);
+        void postValue(const DBAccess::StoryTreeNode &node, Field field, const QString &value);
+        /**
+         * @brief 将所有缓冲值写入数据库
+         */
+        void flush();
+
+    private:
+        DBAccess *desp_ins;
+        QTimer *const idle_timer;
+        // (node-id, field) : (node, latest-value)
+        QHash<QPair<int, int>, QPair<DBAccess::StoryTreeNode, QString>> pending_values;
+    };
+
+    /**
+     * @brief 在线备份任务：经Qt SQLite驱动建立独立连接，于单个读事务内分批复制数据行，
+     * 批间让出时间，轮换保留若干代备份
+     */
+    class BackupWorker : public QObject, public QRunnable
+    {
+        Q_OBJECT
+
+    public:
+        BackupWorker(const QString &sourcePath, const QString &targetDir, int generations);
+
+        // QRunnable interface
+    public:
+        virtual void run() override;
+
+    signals:
+        void backupProgress(int copiedRows, int totalRows);
+        void backupFinished(bool success, const QString &message);
+
+    private:
+        const QString source_path;
+        const QString target_dir;
+        const int generations_count;
+
+        void rotate_generations(const QString &baseName) const;
+        /**
+         * @return 完成返回true，否则failure给出原因
+         */
+        bool copy_snapshot(QSqlDatabase &target, QString &failure);
+    };
+
+    /**
+     * @brief 关键字条目分页模型：按id键集分页载入，字段子行按需由行数据生成
+     *
+     * 根行：Qt::UserRole+1(id)、Qt::UserRole+2(表名)、Qt::UserRole+3(类型名)，第2列为正文提及次数
+     * 字段行：Qt::UserRole+1(存储值)、Qt::UserRole+2(值类型)
+     */
+    class KeywordsTableModel : public QAbstractItemModel
+    {
+    public:
+        KeywordsTableModel(DBAccess *desp, const DBAccess::KeywordField &table, QObject *parent=nullptr);
+        virtual ~KeywordsTableModel() override = default;
+
+        /**
+         * @brief 重设查询条件
+         * @param queryWord 名称片段，“*”代表全部，“名称%n”指定第n字段作为概要显示
+         */
+        void resetQuery(const QString &queryWord);
+        /**
+         * @brief 表结构变更后重新载入字段定义与数据
+         */
+        void refreshSchema();
+        /**
+         * @brief 设置提及次数来源：(表名, id) -> 次数
+         */
+        void setMentionsCounter(std::function<int(const QString &, int)> counter);
+        /**
+         * @brief 提及索引更新后刷新提及次数列
+         */
+        void mentionsUpdated();
+
+        // QAbstractItemModel interface
+    public:
+        virtual QModelIndex index(int row, int column, const QModelIndex &parent) const override;
+        virtual QModelIndex parent(const QModelIndex &child) const override;
+        virtual int rowCount(const QModelIndex &parent) const override;
+        virtual int columnCount(const QModelIndex &parent) const override;
+        virtual bool hasChildren(const QModelIndex &parent) const override;
+        virtual QVariant data(const QModelIndex &index, int role) const override;
+        virtual bool setData(const QModelIndex &index, const QVariant &value, int role) override;
+        virtual Qt::ItemFlags flags(const QModelIndex &index) const override;
+        virtual QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+        virtual bool canFetchMore(const QModelIndex &parent) const override;
+        virtual void fetchMore(const QModelIndex &parent) override;
+
+    private:
+        struct RowRecord{
+            int id;
+            QString name;
+            QList<QVariant> values;     // 字段存储值
+            QStringList displays;       // 字段显示文本
+        };
+
+        DBAccess *const desp_ins;
+        const DBAccess::KeywordField table_define;
+        QString table_name, type_name;
+        QList<DBAccess::KeywordField> columns;
+        QList<DBAccess::KeywordField::ValueType> column_types;
+
+        QString query_name;
+        int display_index;
+        QList<int> matched_ids;     // 名称检索命中的id，升序
+        std::function<int(const QString &, int)> mentions_counter;
+        QList<RowRecord> rows;
+        int last_id;
+        bool exhausted;
+
+        void load_columns();
+        QString summary_of(const RowRecord &record) const;
+    };
+
+    /**
+     * @brief 支线吸附概要，随驻点变更维护，供过滤模型逐行O(1)判定
+     */
+    struct DesplineSummary
+    {
+        int start_volume;
+        QHash<int, int> attached_volumes;   // volume-index : 驻点数量
+        QHash<int, int> attached_chapters;  // chapter-id : 驻点数量
+        int suspended_count;                // 未吸附章节的驻点数量
+
+        bool operator==(const DesplineSummary &other) const{
+            return start_volume == other.start_volume && suspended_count == other.suspended_count
+                    && attached_volumes == other.attached_volumes && attached_chapters == other.attached_chapters;
+        }
+    };
+
+    /**
+     * @brief 全书支线覆盖统计：按章节顺序记录各支线开启与闭合位置，前缀计数惰性重算
+     *
+     * 支线自起始卷宗首章（或更早的吸附章节）开启；驻点全部吸附章节后于最末吸附章节闭合
+     */
+    class DesplineCoverage
+    {
+    public:
+        struct Counts{
+            int opened;     // 本节点内开启
+            int closed;     // 本节点内闭合
+            int remain;     // 章节：截至本章未闭合；卷宗：卷末仍未闭合
+        };
+
+        DesplineCoverage();
+
+        /**
+         * @brief 重设章节序列，清空所有支线记录
+         * @param chapterIDs 全书章节id，按顺序排列
+         * @param volumeChapterCounts 各卷宗章节数量
+         */
+        void resetChapters(const QList<int> &chapterIDs, const QList<int> &volumeChapterCounts);
+        void resetDespline(int desplineID, const DesplineSummary &summary);
+        void removeDespline(int desplineID);
+        /**
+         * @brief 章节结构变化后置为无效，待重设章节序列
+         */
+        void clear();
+
+        bool isValid() const;
+        /**
+         * @brief 指定全书章节序号处的支线计数
+         */
+        Counts chapterCounts(int ordinal) const;
+        Counts volumeCounts(int volumeIndex) const;
+
+    private:
+        bool valid_state;
+        QHash<int, int> chapter_ordinals;       // chapter-id : ordinal
+        QList<int> volume_first_ordinals;       // volume-index : 首章ordinal，末项为章节总数
+        QHash<int, QPair<int, int>> despline_spans; // despline-id : (开启ordinal, 闭合ordinal，-1未闭合)
+        QVector<int> opened_counts, closed_counts;
+        mutable QVector<int> opened_prefix, closed_prefix;
+        mutable bool prefix_dirty;
+
+        void rebuild_prefix() const;
+        int prefix_of(const QVector<int> &prefix, int ordinal) const;
+    };
+
     class DesplineFilterModel : public QSortFilterProxyModel
     {
     public:
@@ -126,6 +346,10 @@ namespace NovelBase {
 
         void setFilterBase(const DBAccess::StoryTreeNode &volume_node, const DBAccess::StoryTreeNode
                            &chapter_node = DBAccess::StoryTreeNode());
+        /**
+         * @brief 设置支线概要来源：despline-id : 概要
+         */
+        void setSummaryIndex(const QHash<int, DesplineSummary> *summaries);
 
         // QSortFilterProxyModel interface
     protected:
@@ -135,6 +359,7 @@ namespace NovelBase {
         Type operate_type_store;
         int volume_filter_index;
         QVariant chapter_filter_id;
+        const QHash<int, DesplineSummary> *summary_index;
     };
 }
 
@@ -153,6 +378,12 @@ public:
      */
     void loadBase(NovelBase::DBAccess *desp);
     void save();
+    /**
+     * @brief 后台在线备份当前作品至指定目录
+     * @param targetDir 备份目录
+     * @param generations 保留备份代数
+     */
+    void backupTo(const QString &targetDir, int generations=5);
 
     QString novelTitle() const;
     void resetNovelTitle(const QString &title);
@@ -198,9 +429,20 @@ public:
     void removeTargetItemViaTheList(const QModelIndex &mindex, const QModelIndex &tIndex);
 
     void queryKeywordsViaTheList(const QModelIndex &mindex, const QString &itemName) const;
+    /**
+     * @brief 由CSV/TSV文件批量导入条目，按文件后缀确定分隔符
+     * @param rejected 因取值无法识别而未导入的记录说明
+     * @return 导入条目数量
+     */
+    int importKeywordsViaTheList(const QModelIndex &mindex, const QString &filePath, QStringList &rejected);
+    void exportKeywordsViaTheList(const QModelIndex &mindex, const QString &filePath) const;
 
     QList<QPair<int, QString>> avaliableEnumsForIndex(const QModelIndex &index) const;
     QList<QPair<int, QString>> avaliableItemsForIndex(const QModelIndex &index) const;
+    /**
+     * @brief 按名称片段增量检索可引用条目
+     */
+    QList<QPair<int, QString>> searchItemsForIndex(const QModelIndex &index, const QString &fragment, int limit) const;
 
 
     QAbstractItemModel *quicklookItemsModel() const;
@@ -223,6 +465,11 @@ public:
      * @return
      */
     QTextDocument *volumeOutlinesPresent() const;
+    /**
+     * @brief 大纲节点在当前卷宗细纲中的标题块
+     * @return 节点不属于当前卷宗时返回无效块
+     */
+    QTextBlock volumeOutlinesTitleBlock(const QModelIndex &outlineNode);
     /**
      * @brief 获取本卷下所有伏笔汇总
      * @return
@@ -373,6 +620,14 @@ public:
 
 
     void searchText(const QString& text);
+    /**
+     * @brief 指定关键字在全书正文中的提及次数
+     */
+    int keywordMentionsCount(const QString &tableName, int uniqueID) const;
+    /**
+     * @brief 将指定关键字的全部提及填入查找结果模型，格式同searchText
+     */
+    void listKeywordMentions(const QString &tableName, int uniqueID);
 
 
 
@@ -380,11 +635,22 @@ public:
     void pushToQuickLook(const QTextBlock &block, const QList<QPair<QString,int>> &mixtureList);
 
     int indexDepth(const QModelIndex &node) const;
+    /**
+     * @brief 刷新字数统计，补记尚无存储字数的章节
+     */
     void refreshWordsCount();
+    /**
+     * @brief 章节有效字数：已载入章节按编辑中文本计算，其余取存储字数，未知返回-1
+     */
+    int chapterWordsCount(const QModelIndex &chapterIndex);
     QString chapterActiveText(const QModelIndex& index);
     int calcValidWordsCount(const QString &content);
 
     void refreshDesplinesSummary();
+    /**
+     * @brief 全书支线覆盖统计：各卷章开启、闭合及未闭合支线数量
+     */
+    QAbstractItemModel *desplinesCoverageChart();
     ConfigHost &getConfigHost() const;
 
     void testMethod();
@@ -402,6 +668,7 @@ signals:
 
     void taskAppended(const QString &taskType, int number);
     void taskFinished(const QString &taskType, const QString &finalTip, int number);
+    void taskProgress(const QString &taskType, int done, int total);
 
     void currentChaptersActived();
     void currentVolumeActived();
@@ -412,7 +679,13 @@ private:
 
     QStandardItemModel *const outline_navigate_treemodel;
     QTextDocument *const novel_outlines_present;
-    QTextDocument *const volume_outlines_present;
+    QTextDocument *volume_outlines_present;             // 当前卷宗细纲，取自缓存
+    // 卷宗细纲文档缓存：volume-id : 文档，lru首位为最近使用
+    QHash<int, QTextDocument*> volume_outlines_cache;
+    QList<int> volume_outlines_lru;
+    // 细纲标题块索引：文档 : (node-id : 标题块起点游标)；游标随编辑自动调整位置，块的userState记录所属节点id，取用时校验
+    QHash<const QTextDocument*, QHash<int, QTextCursor>> volume_outlines_titles;
+    QPair<int, int> volume_outlines_last_change;       // 最近一次变更：(起点, 新增长度)
 
     QStandardItemModel *const chapters_navigate_treemodel;
     QTextDocument *const chapter_outlines_present;
@@ -422,10 +695,38 @@ private:
     NovelBase::DesplineFilterModel *const desplines_filter_until_volume_remain;
     NovelBase::DesplineFilterModel *const desplines_filter_until_chapter_remain;
 
+    // 支线汇总模型索引：id : 首列条目，随变更就地维护
+    QHash<int, QStandardItem*> despline_summary_items;
+    QHash<int, QStandardItem*> attachpoint_summary_items;
+    QHash<int, NovelBase::DesplineSummary> despline_summaries;
+    NovelBase::DesplineCoverage despline_coverage;
+    QStandardItemModel *const desplines_coverage_model;
+    void refresh_despline_coverage();
+    QList<QStandardItem*> despline_summary_row(const NovelBase::DBAccess::StoryTreeNode &despline,
+                                               const NovelBase::DBAccess::StoryTreeNode &volume, int volumeIndex);
+    QList<QStandardItem*> attachpoint_summary_row(const NovelBase::DBAccess::BranchAttachPoint &point);
+    void fill_attachpoint_summary(const QList<QStandardItem*> &row, const NovelBase::DBAccess::BranchAttachPoint &point);
+    void reset_attachpoint_summary(const NovelBase::DBAccess::BranchAttachPoint &point);
+    void reset_despline_summary_state(QStandardItem *despline_item);
+    void renumber_desplines_summary(int volumeIndex);
+    void insert_despline_summary(const NovelBase::DBAccess::StoryTreeNode &despline,
+                                 const NovelBase::DBAccess::StoryTreeNode &volume, int volumeIndex);
+    void sync_desplines_summary_title(const NovelBase::DBAccess::StoryTreeNode &node, const QString &title);
+    void drop_removed_desplines_summary(const QList<QPair<int, QString>> &desplines,
+                                        const QList<NovelBase::DBAccess::StoryTreeController::PointImpact> &points, int removedVolume);
+
+    void remove_volume_node(int volumeIndex);
+    /**
+     * @brief 释放指定章节的内存文档与渲染器
+     */
+    void release_chapter_documents(const QList<QStandardItem*> &chapterItems);
+
     QStandardItemModel *const find_results_model;
+    NovelBase::WriteBehindBuffer *const description_write_behind;
 
     // 所有活动文档存储容器anchor:<doc*,randerer*[nullable]>
     QHash<NovelBase::ChaptersItem*,QPair<QTextDocument*, NovelBase::WordsRender*>> all_documents;
+    QHash<int, int> chapter_words_stored;       // chapter-id : 存储字数
     NovelBase::DBAccess::StoryTreeNode current_volume_node;
     NovelBase::DBAccess::StoryTreeNode current_chapter_node;
     QTextBlock  current_editing_textblock;
@@ -433,10 +734,39 @@ private:
 
 
     QStandardItemModel *const keywords_types_configmodel;
-    QList<QPair<NovelBase::DBAccess::KeywordField, QStandardItemModel*>> keywords_manager_group;
+    QList<QPair<NovelBase::DBAccess::KeywordField, NovelBase::KeywordsTableModel*>> keywords_manager_group;
     void _load_all_keywords_types_only_once();
 
+    // 关键字提及索引：(表名, id) : chapter-id : (start, length)
+    QHash<QPair<QString, int>, QHash<int, QList<QPair<int, int>>>> keyword_mentions;
+    // chapter-id : 本章提及的关键字
+    QHash<int, QSet<QPair<QString, int>>> chapter_mentions;
+    QHash<QTextDocument*, int> mentions_documents;
+    QSet<QTextDocument*> mentions_dirty_documents;
+    // 索引所依据的关键字登记，与ConfigHost比对得出增删改的关键字
+    QHash<QPair<QString, int>, QString> mentions_keywords;
+    // 待索引章节：全量重建的章节，以及仅需补扫指定关键字的章节，按队列分片处理
+    QList<int> mentions_queue;
+    QSet<int> mentions_pending_full;
+    QHash<int, QSet<QPair<QString, int>>> mentions_pending_keys;
+    QTimer *const mentions_reindex_timer;
+    QTimer *const mentions_slice_timer;
+    void _enqueue_chapter_mentions(int chapterID, const QSet<QPair<QString, int>> &keys = QSet<QPair<QString, int>>());
+    void _process_mentions_slice();
+    void _sync_mentions_keywords();
+    void _unindex_chapter_mentions(int chapterID);
+    void _unindex_chapters_mentions(const QList<int> &chapterIDs);
+    void _reindex_chapter_mentions(int chapterID, const QString &content);
+    void _scan_chapter_mentions(int chapterID, const QString &content, const QSet<QPair<QString, int>> &keys);
+    void _flush_dirty_mentions();
+    void _notify_mentions_updated();
+
     QStandardItemModel *const quicklook_backend_model;
+    QList<QPair<QString, int>> quicklook_present_keys;
+    // 快览根条目 : 其展开行涉及的全部条目，据此定位需重建的行
+    QHash<QPair<QString, int>, QSet<QPair<QString, int>>> quicklook_involved;
+    void reset_quicklook_model();
+    void patch_quicklook_model(const QString &tableName, int id);
 
     /**
      * @brief 向chapters-tree和outline-tree上插入卷宗节点
@@ -449,7 +779,11 @@ private:
 
     void listen_novel_description_change();
     void listen_volume_outlines_description_change(int pos, int removed, int added);
-    bool check_volume_structure_diff(const NovelBase::OutlinesItem *base_node, QTextBlock &blk) const;
+    bool check_volume_structure_diff(int pos, int added);
+    /**
+     * @brief 变更区段内的正文块归属（userState）改为其前最近的标题节点
+     */
+    void reown_volume_outlines_blocks(int pos, int added);
     void listen_volume_outlines_structure_changed();
     void listen_chapter_outlines_description_change();
     void outlines_node_title_changed(QStandardItem *item);
@@ -458,12 +792,44 @@ private:
 
     void set_current_volume_outlines(const NovelBase::DBAccess::StoryTreeNode &node_under_volume);
     void set_current_chapter_content(const QModelIndex &chaptersNode, const NovelBase::DBAccess::StoryTreeNode &node);
-    void insert_description_at_volume_outlines_doc(QTextCursor cursor, NovelBase::OutlinesItem *outline_node);
+    void insert_description_at_volume_outlines_doc(QTextCursor cursor, NovelBase::OutlinesItem *outline_node,
+                                                   const QHash<int, QString> &descriptions);
+    void write_volume_outlines_section(QTextCursor &cursor, NovelBase::OutlinesItem *outline_node, const QString &description);
+    void volume_outlines_listening(bool enable);
+    /**
+     * @brief 取得卷宗细纲文档，未缓存则构建并淘汰最久未用者
+     */
+    QTextDocument *volume_outlines_doc(NovelBase::OutlinesItem *volume_item);
+    QTextDocument *cached_volume_outlines_of(QStandardItem *outline_item) const;
+    void evict_volume_outlines(int volumeID);
+    /**
+     * @brief 就地修补已缓存卷宗细纲：插入节点须已挂入大纲树，移除须在摘除条目之前
+     */
+    void patch_volume_outlines_insert(NovelBase::OutlinesItem *outline_node, const QString &description);
+    void patch_volume_outlines_remove(NovelBase::OutlinesItem *outline_node);
+    QStandardItem *outlines_follower_of(QStandardItem *outline_item) const;
+    QTextBlock volume_outlines_title_block(QTextDocument *doc, QStandardItem *outline_item);
+
+    // 导航条目索引：node-id : 条目，卷宗同时登记于两棵树
+    QHash<int, NovelBase::OutlinesItem*> outline_items_index;
+    QHash<int, NovelBase::ChaptersItem*> chapters_items_index;
+    NovelBase::OutlinesItem *new_outlines_item(const NovelBase::DBAccess::StoryTreeNode &node);
+    NovelBase::ChaptersItem *new_chapters_item(const NovelBase::DBAccess::StoryTreeNode &node, bool isGroup=false);
+    /**
+     * @brief 由单次查询的骨架一次性构建两棵导航树
+     */
+    void build_navigate_trees();
+    /**
+     * @brief 条目移除前注销其自身及全部子条目
+     */
+    void forget_navigate_items(QStandardItem *item);
 
     NovelBase::DBAccess::StoryTreeNode _locate_outline_handle_via(QStandardItem *outline_item) const;
+    NovelBase::DBAccess::StoryTreeNode _locate_chapters_handle_via(QStandardItem *chapters_item) const;
     void _check_remove_effect(const NovelBase::DBAccess::StoryTreeNode &target, QList<QString> &msgList) const;
 
     QTextDocument* load_chapter_text_content(QStandardItem* chpAnchor);
+    void store_chapter_text(const NovelBase::DBAccess::StoryTreeNode &chapter, const QString &content);
 
     QModelIndex get_table_presentindex_via_typelist_model(const QModelIndex &mindex) const;
     int extract_tableid_from_the_typelist_model(const QModelIndex &mindex) const;